@@ -1,22 +1,106 @@
 #include "PlanetActor.h"
-#include "ProceduralMeshComponent.h"
+#include "PlanetMeshComponent.h"
+#include "PlanetMemorySubsystem.h"
 #include "MarchingCubesTable.h"
 #include "Materials/MaterialInterface.h"
-#include "KismetProceduralMeshLibrary.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
 #include "DrawDebugHelpers.h"
+#include "Net/UnrealNetwork.h"
+#include "Async/ParallelFor.h"
+#include "Async/Async.h"
+#include "Misc/ScopeLock.h"
+#include "HAL/IConsoleManager.h"
+#include "GameFramework/PlayerController.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogPlanet, Log, All);
+
+static TAutoConsoleVariable<float> CVarPlanetCollisionRecookInterval(
+    TEXT("planet.CollisionRecookInterval"),
+    2.0f,
+    TEXT("Minimum seconds between collision recooks for evicted meshes. Each recook gathers the whole planet on the game thread."),
+    ECVF_Default);
+
+// Corner offsets of a cell in the same order as the lookup tables expect
+static const FIntVector CellCornerOffsets[8] = {
+    FIntVector(0, 0, 0), FIntVector(1, 0, 0), FIntVector(1, 1, 0), FIntVector(0, 1, 0),
+    FIntVector(0, 0, 1), FIntVector(1, 0, 1), FIntVector(1, 1, 1), FIntVector(0, 1, 1)
+};
+
+// One resolution of the planet, built in the background and swapped onto the mesh when done
+struct FPlanetGenerationPass
+{
+    int32 GridSize = 0;
+    bool bFinal = false;
+    double BuildSeconds = 0.0;
+    FPlanetGridLayout Layout;
+    TArray<FPlanetChunk> Chunks;
+    TArray<FPlanetMeshSection> Sections;
+    TArray<FPlanetChunkScatter> Scatter; // Only the final pass is scattered
+};
 
 // Sets default values
 APlanetActor::APlanetActor()
 {
-    // Create a ProceduralMeshComponent and set it as the root component
-    PlanetMesh = CreateDefaultSubobject<UProceduralMeshComponent>(TEXT("GeneratedMesh"));
+    // Create a PlanetMeshComponent and set it as the root component
+    PlanetMesh = CreateDefaultSubobject<UPlanetMeshComponent>(TEXT("GeneratedMesh"));
     RootComponent = PlanetMesh;
 
     // Enable ticking
     PrimaryActorTick.bCanEverTick = true;
 
+    // Planets are edited by every player, so replicate them to everyone
+    bReplicates = true;
+    bAlwaysRelevant = true;
+
     // Set a default radius for the planet
     Radius = 400.0f;  // Adjustable in the editor
+
+    GridSize = 192;
+    VoxelSize = 16.0f;
+    ChunkSize = 32;
+
+    bProgressiveGeneration = true;
+    ProgressiveStartGridSize = 24;
+    bGenerationCancelled = false;
+    bMeshTaskRunning = false;
+
+    NoiseScale = 0.01f;
+    NoiseAmplitude = 75.0f;
+    NoiseSeed = 0;
+    NoiseOffset = FVector::ZeroVector;
+
+    bUseNoiseVolume = false;
+    bNoiseVolumeBaked = false;
+    NoiseVolumeResolution = 4;
+    NoiseVolumeFilter = EPlanetNoiseFilter::Trilinear;
+
+    ChunkViewDistance = 10000.0f;
+    bCollisionStale = false;
+    LastCollisionCookTime = 0.0;
+
+    MaxEditLogOps = 256;
+    MaxBrushRadius = 1000.0f;
+    MaxBrushStrength = 500.0f;
+    DensityLipschitz = 3.0f;
+    BakedSequence = 0;
+    AppliedSequence = 0;
+    IssuedSequence = 0;
+
+    EditLog.Owner = this;
+    BakedEdits.Owner = this;
+
+    // Queries before BeginPlay see an empty snapshot and fall back to the analytic density
+    DensitySnapshot = MakeShared<FPlanetDensitySnapshot, ESPMode::ThreadSafe>();
+    bSnapshotStale = false;
+}
+
+void APlanetActor::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+    Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+    DOREPLIFETIME(APlanetActor, EditLog);
+    DOREPLIFETIME(APlanetActor, BakedEdits);
+    DOREPLIFETIME(APlanetActor, BakedSequence);
 }
 
 // Called when the game starts or when spawned
@@ -24,101 +108,173 @@ void APlanetActor::BeginPlay()
 {
     Super::BeginPlay();
 
+    if (UPlanetMemorySubsystem* Memory = GetWorld()->GetSubsystem<UPlanetMemorySubsystem>())
+    {
+        Memory->RegisterPlanet(this);
+    }
+
     // Generate the planet mesh
     GeneratePlanet();
 }
 
+void APlanetActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    // Background passes and mesh builds read this actor's settings, so make sure none outlive it
+    bGenerationCancelled = true;
+    if (GenerationTask.IsValid())
+    {
+        GenerationTask.Wait();
+    }
+    if (MeshTask.IsValid())
+    {
+        MeshTask.Wait();
+    }
+
+    if (UPlanetMemorySubsystem* Memory = GetWorld()->GetSubsystem<UPlanetMemorySubsystem>())
+    {
+        Memory->UnregisterPlanet(this);
+    }
+
+    Super::EndPlay(EndPlayReason);
+}
+
 // Called every frame
 void APlanetActor::Tick(float DeltaTime)
 {
     Super::Tick(DeltaTime);
+
+    // Queries from other threads can't read the actor transform safely, so they use the snapshot's copy
+    if (!GetActorTransform().Equals(DensitySnapshot->Transform))
+    {
+        bSnapshotStale = true;
+    }
+
+    UpdateChunkViewTimes();
+    AdoptReloadedChunks();
+    PublishDensitySnapshot();
+    RebuildDirtyChunks();
+
+    // A running mesh batch cooks when it lands, so stale collision can wait for it
+    if (bCollisionStale && !bMeshTaskRunning && GetWorld()->GetTimeSeconds() - LastCollisionCookTime >= CVarPlanetCollisionRecookInterval.GetValueOnGameThread())
+    {
+        CookCollision();
+    }
+}
+
+void APlanetActor::CookCollision()
+{
+    bCollisionStale = false;
+    LastCollisionCookTime = GetWorld()->GetTimeSeconds();
+    PlanetMesh->UpdateCollision();
 }
 
-// Function to generate the voxel grid
-void APlanetActor::GenerateVoxelGrid(int GridSize, float VoxelSize, TArray<FVoxel>& OutVoxels)
+// Function to generate the voxel grid for a chunk
+void APlanetActor::GenerateVoxelGrid(const FPlanetGridLayout& InLayout, const FIntVector& ChunkCoord, const TArray<float>& Density, TArray<FVoxel>& OutVoxels) const
 {
-    // Center the grid around (0, 0, 0)
-    FVector GridCenterOffset = FVector(GridSize / 2.0f) * VoxelSize;
+    const int32 CellsPerAxis = InLayout.ChunkSize;
 
-    // Actor Transforms for Visualization
-    //FTransform ActorTransform = GetActorTransform();
-    //FQuat ActorRotation = ActorTransform.GetRotation();
-    
-    for (int x = 0; x < GridSize; x++)
+    OutVoxels.Reserve(CellsPerAxis * CellsPerAxis * CellsPerAxis);
+
+    for (int x = 0; x < CellsPerAxis; x++)
     {
-        for (int y = 0; y < GridSize; y++)
+        for (int y = 0; y < CellsPerAxis; y++)
         {
-            for (int z = 0; z < GridSize; z++)
+            for (int z = 0; z < CellsPerAxis; z++)
             {
                 FVoxel NewVoxel;
-                FVector BasePosition = FVector(x, y, z) * VoxelSize;
-
-                // Offset the base position to center the grid around (0, 0, 0)
-                BasePosition -= GridCenterOffset;
 
-                // Define the voxel corners based on the base position
-                NewVoxel.CornerPositions[0] = BasePosition;
-                NewVoxel.CornerPositions[1] = BasePosition + FVector(VoxelSize, 0, 0);
-                NewVoxel.CornerPositions[2] = BasePosition + FVector(VoxelSize, VoxelSize, 0);
-                NewVoxel.CornerPositions[3] = BasePosition + FVector(0, VoxelSize, 0);
-                NewVoxel.CornerPositions[4] = BasePosition + FVector(0, 0, VoxelSize);
-                NewVoxel.CornerPositions[5] = BasePosition + FVector(VoxelSize, 0, VoxelSize);
-                NewVoxel.CornerPositions[6] = BasePosition + FVector(VoxelSize, VoxelSize, VoxelSize);
-                NewVoxel.CornerPositions[7] = BasePosition + FVector(0, VoxelSize, VoxelSize);
+                // Define the voxel corners from the chunk's shared corner samples
+                for (int CornerIndex = 0; CornerIndex < 8; CornerIndex++)
+                {
+                    const FIntVector Corner = FIntVector(x, y, z) + CellCornerOffsets[CornerIndex];
+                    NewVoxel.CornerPositions[CornerIndex] = InLayout.GetSamplePosition(ChunkCoord, Corner.X, Corner.Y, Corner.Z);
+                    NewVoxel.CornerValues[CornerIndex] = Density[FPlanetChunk::SampleIndex(Corner.X, Corner.Y, Corner.Z, CellsPerAxis)];
+                }
 
                 OutVoxels.Add(NewVoxel);
-
-                
-                FVector Center = BasePosition + FVector(VoxelSize / 2.0f);
-               // FVector TransformedCenter = ActorTransform.TransformPosition(Center);
-                //FVector TransformedScale = ActorTransform.GetScale3D() * (VoxelSize / 2.0f); 
-                //DrawDebugBox(GetWorld(), TransformedCenter, TransformedScale, ActorRotation, FColor::Green, true, 20.0f);
-                
-
             }
         }
     }
-
-    // Assign density values to the voxels
-    AssignDensityValues(OutVoxels, GridSize, VoxelSize);
 }
 
-// Function to assign density values based on distance from the planet's center
-void APlanetActor::AssignDensityValues(TArray<FVoxel>& Voxels, int GridSize, float VoxelSize)
+// Function to calculate the unedited density at a position based on distance from the planet's center
+float APlanetActor::SampleBaseDensity(const FVector& Position, const FPlanetNoiseVolume* Volume) const
 {
     // Center the sphere at (0, 0, 0)
-    FVector PlanetCenter = FVector(0, 0, 0);
+    const FVector PlanetCenter = FVector(0, 0, 0);
 
-    // Noise parameters
-    float NoiseScale = 0.01f; // Needs to be Clamped
-    float NoiseAmplitude = 75.0f; // Noise Strength
+    // Calculate the distance from the planet's center to the sample
+    const float Distance = FVector::Dist(Position, PlanetCenter);
 
-    for (FVoxel& Voxel : Voxels)
+    // Generate 3D Perlin noise based on the sample position, from the baked volume when there is one
+    const FVector NoisePosition = Position * NoiseScale + NoiseOffset;
+    float NoiseValue;
+    if (!Volume || !Volume->Sample(NoisePosition, NoiseVolumeFilter, NoiseValue))
     {
-        for (int CornerIndex = 0; CornerIndex < 8; CornerIndex++)
-        {
-            FVector CornerPosition = Voxel.CornerPositions[CornerIndex];
+        NoiseValue = FMath::PerlinNoise3D(NoisePosition);
+    }
 
-            // Calculate the distance from the planet's center to the voxel corner
-            float Distance = FVector::Dist(CornerPosition, PlanetCenter);
+    // Adjust the noise amplitude to affect the terrain
+    NoiseValue *= NoiseAmplitude;
 
-            // Generate 3D Perlin noise based on the corner position
-            float NoiseValue = FMath::PerlinNoise3D(CornerPosition * NoiseScale);
+    // Calculate the density value with added noise for surface variety
+    return (Radius - Distance) + NoiseValue;
+}
 
-            // Adjust the noise amplitude to affect the terrain
-            NoiseValue *= NoiseAmplitude;
+// Function to assign the unedited density values to every sample of a chunk
+void APlanetActor::AssignDensityValues(const FPlanetGridLayout& InLayout, const FIntVector& ChunkCoord, TArray<float>& OutDensity) const
+{
+    const int32 SamplesPerAxis = InLayout.ChunkSize + 1;
+    OutDensity.SetNumUninitialized(SamplesPerAxis * SamplesPerAxis * SamplesPerAxis);
 
-            // Calculate the density value with added noise for surface variety
-            Voxel.CornerValues[CornerIndex] = (Radius - Distance) + NoiseValue;
+    for (int z = 0; z < SamplesPerAxis; z++)
+    {
+        for (int y = 0; y < SamplesPerAxis; y++)
+        {
+            for (int x = 0; x < SamplesPerAxis; x++)
+            {
+                const FVector Position = InLayout.GetSamplePosition(ChunkCoord, x, y, z);
+                OutDensity[FPlanetChunk::SampleIndex(x, y, z, InLayout.ChunkSize)] = SampleBaseDensity(Position, NoiseVolume.Get());
+            }
         }
     }
 }
 
+// Function to add a decompressed baked delta onto a chunk's base density
+static void AddBakedDelta(const TArray<int16>& QuantisedDelta, TArray<float>& InOutDensity)
+{
+    for (int32 SampleIndex = 0; SampleIndex < InOutDensity.Num(); SampleIndex++)
+    {
+        InOutDensity[SampleIndex] += QuantisedDelta[SampleIndex] * FPlanetBakedEdits::DeltaQuantum;
+    }
+}
+
+// Function to regenerate an evicted chunk's density: its base density, plus its baked delta if it was
+// edited. Only chunks with no edits since their bake are evicted, so this rebuilds exactly what
+// RefreshBakedChunk or CompactEditLog left. Safe to call off the game thread.
+void APlanetActor::ReloadChunkDensity(const FPlanetGridLayout& InLayout, const FIntVector& ChunkCoord, const FPlanetEvictedDensity* Evicted, TArray<float>& OutDensity) const
+{
+    AssignDensityValues(InLayout, ChunkCoord, OutDensity);
+    if (!Evicted)
+    {
+        return;
+    }
+
+    TArray<int16> QuantisedDelta;
+    if (!FPlanetBakedEdits::UncompressChunkDelta(Evicted->CompressedDelta, OutDensity.Num(), QuantisedDelta))
+    {
+        UE_LOG(LogPlanet, Error, TEXT("%s: failed to reload edits for chunk (%d, %d, %d)"), *GetName(), ChunkCoord.X, ChunkCoord.Y, ChunkCoord.Z);
+        return;
+    }
+
+    AddBakedDelta(QuantisedDelta, OutDensity);
+}
+
 // Function to generate mesh using marching cubes
-void APlanetActor::MarchingCubes(TArray<FVoxel>& Voxels, TArray<FVector>& Vertices, TArray<int32>& Triangles, int GridSize, float VoxelSize)
+void APlanetActor::MarchingCubes(const TArray<FVoxel>& Voxels, TArray<FVector>& Vertices, TArray<int32>& Triangles) const
 {
-    
-    
+
+
     for (const FVoxel& Voxel : Voxels)
     {
         int VoxelConfig = 0;
@@ -155,7 +311,7 @@ void APlanetActor::MarchingCubes(TArray<FVoxel>& Voxels, TArray<FVector>& Vertic
             Vertices.Add(EdgeVertices[MarchingCubesTable::TRI_TABLE[VoxelConfig][i]]);
             Vertices.Add(EdgeVertices[MarchingCubesTable::TRI_TABLE[VoxelConfig][i + 1]]);
             Vertices.Add(EdgeVertices[MarchingCubesTable::TRI_TABLE[VoxelConfig][i + 2]]);
-            
+
             Triangles.Add(VertexIndex);
             Triangles.Add(VertexIndex + 1);
             Triangles.Add(VertexIndex + 2);
@@ -163,42 +319,1401 @@ void APlanetActor::MarchingCubes(TArray<FVoxel>& Voxels, TArray<FVector>& Vertic
     }
 }
 
+// Function to generate a chunk's mesh using marching cubes straight from its samples. Each z slice
+// of samples is unpacked once into a flat row-major buffer with its inside bits, and becomes the
+// lower slice when the walk moves up, so every sample is read from the chunk once rather than by
+// all eight cells that share it. Along a row, the right face of one cell is the left face of the
+// next, so only four new case bits are needed per cell. Produces the same triangles as walking the
+// voxel grid, in a different order.
+void APlanetActor::MarchingCubes(const FPlanetGridLayout& InLayout, const FIntVector& ChunkCoord, const TArray<float>& Density, TArray<FVector>& Vertices, TArray<int32>& Triangles) const
+{
+    const int32 CellsPerAxis = InLayout.ChunkSize;
+    const int32 SamplesPerAxis = CellsPerAxis + 1;
+    const int32 SliceSamples = SamplesPerAxis * SamplesPerAxis;
+
+    TArray<float> SliceValues;
+    TArray<uint8> SliceInside;
+    SliceValues.SetNumUninitialized(SliceSamples * 2);
+    SliceInside.SetNumUninitialized(SliceSamples * 2);
+
+    float* LowerValues = SliceValues.GetData();
+    float* UpperValues = LowerValues + SliceSamples;
+    uint8* LowerInside = SliceInside.GetData();
+    uint8* UpperInside = LowerInside + SliceSamples;
+
+    const auto LoadSlice = [&Density, CellsPerAxis, SamplesPerAxis](int32 z, float* OutValues, uint8* OutInside)
+    {
+        for (int32 y = 0; y < SamplesPerAxis; y++)
+        {
+            for (int32 x = 0; x < SamplesPerAxis; x++)
+            {
+                const float Value = Density[FPlanetChunk::SampleIndex(x, y, z, CellsPerAxis)];
+                OutValues[x + y * SamplesPerAxis] = Value;
+                OutInside[x + y * SamplesPerAxis] = Value > 0 ? 1 : 0;
+            }
+        }
+    };
+
+    LoadSlice(0, LowerValues, LowerInside);
+
+    for (int32 z = 0; z < CellsPerAxis; z++)
+    {
+        if (z > 0)
+        {
+            Swap(LowerValues, UpperValues);
+            Swap(LowerInside, UpperInside);
+        }
+        LoadSlice(z + 1, UpperValues, UpperInside);
+
+        for (int32 y = 0; y < CellsPerAxis; y++)
+        {
+            const int32 Row = y * SamplesPerAxis;
+
+            // Start with the row's first face in the right face bits (1, 2, 5 and 6), as if a cell came before it
+            int32 VoxelConfig = (LowerInside[Row] << 1) | (LowerInside[Row + SamplesPerAxis] << 2) | (UpperInside[Row] << 5) | (UpperInside[Row + SamplesPerAxis] << 6);
+
+            for (int32 x = 0; x < CellsPerAxis; x++)
+            {
+                const int32 Base = Row + x;
+
+                // Corners 1, 2, 5 and 6 of the last cell are corners 0, 3, 4 and 7 of this one
+                VoxelConfig = ((VoxelConfig & 0x22) >> 1) | ((VoxelConfig & 0x44) << 1)
+                    | (LowerInside[Base + 1] << 1) | (LowerInside[Base + SamplesPerAxis + 1] << 2)
+                    | (UpperInside[Base + 1] << 5) | (UpperInside[Base + SamplesPerAxis + 1] << 6);
+
+                const int EdgeMask = MarchingCubesTable::EDGE_TABLE[VoxelConfig];
+                if (EdgeMask == 0)
+                {
+                    continue;
+                }
+
+                const float CornerValues[8] = {
+                    LowerValues[Base], LowerValues[Base + 1], LowerValues[Base + SamplesPerAxis + 1], LowerValues[Base + SamplesPerAxis],
+                    UpperValues[Base], UpperValues[Base + 1], UpperValues[Base + SamplesPerAxis + 1], UpperValues[Base + SamplesPerAxis]
+                };
+
+                // Corner positions are only worked out for the edges the surface crosses
+                FVector EdgeVertices[12];
+                for (int i = 0; i < 12; i++)
+                {
+                    if (EdgeMask & (1 << i))
+                    {
+                        const int32 CornerIndexA = MarchingCubesTable::EDGE_VERTICES[i][0];
+                        const int32 CornerIndexB = MarchingCubesTable::EDGE_VERTICES[i][1];
+                        const FIntVector CornerA = FIntVector(x, y, z) + CellCornerOffsets[CornerIndexA];
+                        const FIntVector CornerB = FIntVector(x, y, z) + CellCornerOffsets[CornerIndexB];
+
+                        EdgeVertices[i] = InterpolateEdge(
+                            InLayout.GetSamplePosition(ChunkCoord, CornerA.X, CornerA.Y, CornerA.Z),
+                            InLayout.GetSamplePosition(ChunkCoord, CornerB.X, CornerB.Y, CornerB.Z),
+                            CornerValues[CornerIndexA], CornerValues[CornerIndexB]);
+                    }
+                }
+
+                for (int i = 0; MarchingCubesTable::TRI_TABLE[VoxelConfig][i] != -1; i += 3)
+                {
+                    int32 VertexIndex = Vertices.Num();
+                    Vertices.Add(EdgeVertices[MarchingCubesTable::TRI_TABLE[VoxelConfig][i]]);
+                    Vertices.Add(EdgeVertices[MarchingCubesTable::TRI_TABLE[VoxelConfig][i + 1]]);
+                    Vertices.Add(EdgeVertices[MarchingCubesTable::TRI_TABLE[VoxelConfig][i + 2]]);
+
+                    Triangles.Add(VertexIndex);
+                    Triangles.Add(VertexIndex + 1);
+                    Triangles.Add(VertexIndex + 2);
+                }
+            }
+        }
+    }
+}
+
 // Function to interpolate the edge between two corners
-FVector APlanetActor::InterpolateEdge(const FVector& CornerA, const FVector& CornerB, float ValueA, float ValueB)
+FVector APlanetActor::InterpolateEdge(const FVector& CornerA, const FVector& CornerB, float ValueA, float ValueB) const
 {
     float t = ValueA / (ValueA - ValueB);
     return CornerA + t * (CornerB - CornerA);
 }
 
-// Function to generate the planet
-void APlanetActor::GeneratePlanet()
+// Function to polygonise a single chunk of a snapshot into a packed mesh section
+void APlanetActor::PolygoniseChunk(const FPlanetDensitySnapshot& Snapshot, int32 ChunkIndex, FPlanetMeshSection& OutSection) const
 {
-    int GridSize = 192;  // Size of bounds for voxel grid (increase for more detail)
-    float VoxelSize = 16.0f;  // Size of each voxel - lower means more detail
+    const FIntVector ChunkCoord = Snapshot.Layout.GetChunkCoord(ChunkIndex);
 
-    TArray<FVoxel> Voxels;
-    GenerateVoxelGrid(GridSize, VoxelSize, Voxels);
-    
     // Arrays to hold generated mesh data
     TArray<FVector> Vertices;
     TArray<int32> Triangles;
-    TArray<FVector> Normals;
-    TArray<FVector2D> UVs;
-    TArray<FLinearColor> VertexColors;
-    TArray<FProcMeshTangent> Tangents;
 
     // Generate the mesh data using marching cubes
-    MarchingCubes(Voxels, Vertices, Triangles, GridSize, VoxelSize);
+    MarchingCubes(Snapshot.Layout, ChunkCoord, Snapshot.Chunks[ChunkIndex]->Density, Vertices, Triangles);
 
-    // Calculate normals and tangents
-    UKismetProceduralMeshLibrary::CalculateTangentsForMesh(Vertices, Triangles, UVs, Normals, Tangents);
+    // Pack the mesh relative to the chunk bounds
+    OutSection = FPlanetMeshSection();
+    OutSection.Bounds = Snapshot.Layout.GetChunkBounds(ChunkCoord);
+    OutSection.Vertices.Reserve(Vertices.Num());
+    OutSection.Indices.Reserve(Triangles.Num());
 
-    // Update the procedural mesh component with the generated data
-    PlanetMesh->CreateMeshSection_LinearColor(0, Vertices, Triangles, Normals, UVs, VertexColors, Tangents, true);
-    
-    // Optional: Apply the material (if already set in the blueprint or elsewhere)
-    if (PlanetMaterial)
+    // Normals come from the density gradient, which is smooth across chunk borders
+    for (const FVector& Vertex : Vertices)
     {
-        PlanetMesh->SetMaterial(0, PlanetMaterial);
-    } 
-}
\ No newline at end of file
+        OutSection.AddVertex(Vertex, -SampleGradientLocal(Snapshot, Vertex));
+    }
+
+    for (int32 Index : Triangles)
+    {
+        OutSection.Indices.Add(static_cast<uint32>(Index));
+    }
+}
+
+// Function to re-polygonise chunks changed since they were last meshed, and regenerate evicted density
+// that's needed again, on a worker thread
+void APlanetActor::RebuildDirtyChunks()
+{
+    // Chunks edited while a batch is running keep their new version and go in the next batch
+    if (bMeshTaskRunning || bGenerationCancelled)
+    {
+        return;
+    }
+
+    TArray<int32> DirtyChunks;
+    TArray<int32> ReloadChunks; // Evicted chunks whose density the worker regenerates
+    TBitArray<> bQueuedForReload(false, Chunks.Num());
+    const double Now = GetWorld()->GetTimeSeconds();
+
+    const auto QueueReload = [this, &ReloadChunks, &bQueuedForReload](int32 ChunkIndex)
+    {
+        if (!Chunks[ChunkIndex].Data.IsValid() && !bQueuedForReload[ChunkIndex])
+        {
+            bQueuedForReload[ChunkIndex] = true;
+            ReloadChunks.Add(ChunkIndex);
+        }
+    };
+
+    for (int32 ChunkIndex = 0; ChunkIndex < Chunks.Num(); ChunkIndex++)
+    {
+        const FPlanetChunk& Chunk = Chunks[ChunkIndex];
+
+        // Evicted meshes wait until the chunk is viewed again. Evicted density is always clean,
+        // unless the mesh has been restored and needs building from it.
+        const bool bNeedsMesh = Chunk.Data.IsValid() ? Chunk.Data->Version != Chunk.MeshedVersion : Chunk.MeshedVersion == FPlanetChunk::UnmeshedVersion;
+        if (bNeedsMesh && !Chunk.bMeshEvicted)
+        {
+            DirtyChunks.Add(ChunkIndex);
+
+            // Normals read across chunk borders, so evicted neighbours come back with the chunk
+            for (int32 dz = -1; dz <= 1; dz++)
+            {
+                for (int32 dy = -1; dy <= 1; dy++)
+                {
+                    for (int32 dx = -1; dx <= 1; dx++)
+                    {
+                        const FIntVector Neighbour = Chunk.Coord + FIntVector(dx, dy, dz);
+                        if (Neighbour.X >= 0 && Neighbour.Y >= 0 && Neighbour.Z >= 0 &&
+                            Neighbour.X < Layout.ChunksPerAxis && Neighbour.Y < Layout.ChunksPerAxis && Neighbour.Z < Layout.ChunksPerAxis)
+                        {
+                            QueueReload(Layout.GetChunkIndex(Neighbour));
+                        }
+                    }
+                }
+            }
+        }
+        else if (Chunk.LastViewedTime >= Now)
+        {
+            // Viewed chunks are likely to be edited or queried, so bring them back before that happens on the game thread
+            QueueReload(ChunkIndex);
+        }
+    }
+
+    if (DirtyChunks.Num() == 0 && ReloadChunks.Num() == 0)
+    {
+        return;
+    }
+
+    // Density is only evicted while the mesh is up to date, so the reloaded data is that version
+    TArray<uint32> ReloadVersions;
+    ReloadVersions.Reserve(ReloadChunks.Num());
+    for (int32 ChunkIndex : ReloadChunks)
+    {
+        const uint32 MeshedVersion = Chunks[ChunkIndex].MeshedVersion;
+        ReloadVersions.Add(MeshedVersion == FPlanetChunk::UnmeshedVersion ? 0 : MeshedVersion);
+    }
+
+    // The worker reads the published snapshot, so edits can carry on while it runs
+    PublishDensitySnapshot();
+    TSharedPtr<const FPlanetDensitySnapshot, ESPMode::ThreadSafe> Snapshot = DensitySnapshot;
+    TWeakObjectPtr<APlanetActor> WeakThis(this);
+    bMeshTaskRunning = true;
+
+    MeshTask = Async(EAsyncExecution::ThreadPool, [this, WeakThis, Snapshot, DirtyChunks = MoveTemp(DirtyChunks), ReloadChunks = MoveTemp(ReloadChunks), ReloadVersions = MoveTemp(ReloadVersions)]()
+    {
+        // Regenerate evicted density here rather than on the game thread, and mesh from a copy of the snapshot that includes it
+        TArray<TSharedPtr<FPlanetChunkData, ESPMode::ThreadSafe>> Reloaded;
+        Reloaded.SetNum(ReloadChunks.Num());
+
+        ParallelFor(ReloadChunks.Num(), [this, &Snapshot, &ReloadChunks, &ReloadVersions, &Reloaded](int32 Index)
+        {
+            if (bGenerationCancelled)
+            {
+                return;
+            }
+
+            TSharedPtr<FPlanetChunkData, ESPMode::ThreadSafe> NewData = MakeShared<FPlanetChunkData, ESPMode::ThreadSafe>();
+            NewData->Version = ReloadVersions[Index];
+            ReloadChunkDensity(Snapshot->Layout, Snapshot->Layout.GetChunkCoord(ReloadChunks[Index]), Snapshot->Evicted[ReloadChunks[Index]].Get(), NewData->Density);
+            Reloaded[Index] = MoveTemp(NewData);
+        });
+
+        if (bGenerationCancelled)
+        {
+            return;
+        }
+
+        TSharedPtr<FPlanetDensitySnapshot, ESPMode::ThreadSafe> MeshSnapshot = MakeShared<FPlanetDensitySnapshot, ESPMode::ThreadSafe>(*Snapshot);
+        for (int32 Index = 0; Index < ReloadChunks.Num(); Index++)
+        {
+            MeshSnapshot->Chunks[ReloadChunks[Index]] = Reloaded[Index];
+        }
+
+        TSharedPtr<TArray<FPlanetMeshSection>, ESPMode::ThreadSafe> Sections = MakeShared<TArray<FPlanetMeshSection>, ESPMode::ThreadSafe>();
+        TSharedPtr<TArray<FPlanetChunkScatter>, ESPMode::ThreadSafe> Scatter = MakeShared<TArray<FPlanetChunkScatter>, ESPMode::ThreadSafe>();
+        Sections->SetNum(DirtyChunks.Num());
+        Scatter->SetNum(ScatterRules.Num() > 0 ? DirtyChunks.Num() : 0);
+
+        ParallelFor(DirtyChunks.Num(), [this, &MeshSnapshot, &DirtyChunks, &Sections, &Scatter](int32 Index)
+        {
+            if (bGenerationCancelled)
+            {
+                return;
+            }
+
+            PolygoniseChunk(*MeshSnapshot, DirtyChunks[Index], (*Sections)[Index]);
+
+            if (Scatter->IsValidIndex(Index))
+            {
+                FPlanetScatter::ScatterSection((*Sections)[Index], ScatterRules, Radius, NoiseSeed, (*Scatter)[Index]);
+            }
+        });
+
+        AsyncTask(ENamedThreads::GameThread, [WeakThis, MeshSnapshot, DirtyChunks, ReloadChunks, Reloaded = MoveTemp(Reloaded), Sections, Scatter]()
+        {
+            APlanetActor* Planet = WeakThis.Get();
+            if (!Planet || Planet->bGenerationCancelled)
+            {
+                return;
+            }
+
+            // Only the pointer swap happens here. Chunks an edit brought back in the meantime keep that data.
+            for (int32 Index = 0; Index < ReloadChunks.Num(); Index++)
+            {
+                FPlanetChunk& Chunk = Planet->Chunks[ReloadChunks[Index]];
+                if (!Chunk.Data.IsValid())
+                {
+                    Chunk.Data = Reloaded[Index];
+                    Chunk.Evicted.Reset();
+                    Planet->bSnapshotStale = true;
+                }
+            }
+
+            // Update the planet mesh component with the generated data, replacing only these chunks' buffers
+            for (int32 Index = 0; Index < DirtyChunks.Num(); Index++)
+            {
+                const int32 ChunkIndex = DirtyChunks[Index];
+                Planet->PlanetMesh->SetChunkSection(ChunkIndex, MoveTemp((*Sections)[Index]));
+                Planet->Chunks[ChunkIndex].MeshedVersion = MeshSnapshot->Chunks[ChunkIndex]->Version;
+
+                if (Scatter->IsValidIndex(Index))
+                {
+                    Planet->ApplyChunkScatter(ChunkIndex, (*Scatter)[Index]);
+                }
+            }
+
+            // Cook collision once for the whole batch rather than once per chunk, picking up any evictions too
+            if (DirtyChunks.Num() > 0 || Planet->bCollisionStale)
+            {
+                Planet->CookCollision();
+            }
+            Planet->bMeshTaskRunning = false;
+        });
+    });
+}
+
+// Function to replace a chunk's scattered instances, creating its instanced components on first use
+void APlanetActor::ApplyChunkScatter(int32 ChunkIndex, FPlanetChunkScatter& Scatter)
+{
+    const int32 NumRules = ScatterRules.Num();
+    if (ScatterComponents.Num() < Chunks.Num() * NumRules)
+    {
+        ScatterComponents.SetNumZeroed(Chunks.Num() * NumRules);
+    }
+
+    for (int32 RuleIndex = 0; RuleIndex < NumRules && RuleIndex < Scatter.RuleInstances.Num(); RuleIndex++)
+    {
+        const FPlanetScatterRule& Rule = ScatterRules[RuleIndex];
+        const TArray<FTransform>& Instances = Scatter.RuleInstances[RuleIndex];
+        UHierarchicalInstancedStaticMeshComponent*& Component = ScatterComponents[ChunkIndex * NumRules + RuleIndex];
+
+        if (Instances.Num() == 0)
+        {
+            if (Component)
+            {
+                Component->ClearInstances();
+            }
+            continue;
+        }
+
+        // A component per chunk keeps re-scattering one chunk from rebuilding every instance tree
+        if (!Component)
+        {
+            Component = NewObject<UHierarchicalInstancedStaticMeshComponent>(this);
+            Component->SetStaticMesh(Rule.Mesh);
+            Component->SetCollisionEnabled(Rule.bEnableCollision ? ECollisionEnabled::QueryAndPhysics : ECollisionEnabled::NoCollision);
+            Component->SetCullDistances(0, Rule.CullDistance);
+            Component->SetupAttachment(PlanetMesh);
+            Component->RegisterComponent();
+        }
+
+        // Instances are planet-local, which is the component's space since it sits on the planet mesh
+        Component->ClearInstances();
+        Component->AddInstances(Instances, false, false);
+    }
+}
+
+// Function to make the current chunk versions visible to readers on other threads
+void APlanetActor::PublishDensitySnapshot()
+{
+    if (!bSnapshotStale)
+    {
+        return;
+    }
+
+    TSharedPtr<FPlanetDensitySnapshot, ESPMode::ThreadSafe> NewSnapshot = MakeShared<FPlanetDensitySnapshot, ESPMode::ThreadSafe>();
+    NewSnapshot->Layout = Layout;
+    NewSnapshot->SetChunks(Chunks);
+    NewSnapshot->Reloaded = MakeShared<FPlanetReloadedChunks, ESPMode::ThreadSafe>();
+    NewSnapshot->NoiseVolume = NoiseVolume;
+    NewSnapshot->Transform = GetActorTransform();
+
+    // Swap rather than assign, so the old snapshot is released after the lock is dropped
+    TSharedPtr<const FPlanetDensitySnapshot, ESPMode::ThreadSafe> OldSnapshot = NewSnapshot;
+    {
+        FWriteScopeLock Lock(DensityLock);
+        Swap(DensitySnapshot, OldSnapshot);
+    }
+    bSnapshotStale = false;
+}
+
+TSharedPtr<const FPlanetDensitySnapshot, ESPMode::ThreadSafe> APlanetActor::GetDensitySnapshot() const
+{
+    FReadScopeLock Lock(DensityLock);
+    return DensitySnapshot;
+}
+
+// Function to get a chunk's data for writing without disturbing snapshots that hold the current version
+FPlanetChunkData& APlanetActor::EditChunkData(FPlanetChunk& Chunk)
+{
+    EnsureChunkResident(Chunk);
+
+    // Only the game thread hands out references, so if nobody else holds the data nobody can start to
+    if (!Chunk.Data.IsUnique())
+    {
+        Chunk.Data = MakeShared<FPlanetChunkData, ESPMode::ThreadSafe>(*Chunk.Data);
+    }
+
+    Chunk.Data->Version++;
+    bSnapshotStale = true;
+    return *Chunk.Data;
+}
+
+// Function to bring an evicted chunk's density back on the game thread, with its baked edits if it has any
+void APlanetActor::EnsureChunkResident(FPlanetChunk& Chunk)
+{
+    if (Chunk.Data.IsValid())
+    {
+        return;
+    }
+
+    // Density is only evicted while the mesh is up to date, so the reloaded data is that version
+    TSharedPtr<FPlanetChunkData, ESPMode::ThreadSafe> NewData = MakeShared<FPlanetChunkData, ESPMode::ThreadSafe>();
+    NewData->Version = Chunk.MeshedVersion == FPlanetChunk::UnmeshedVersion ? 0 : Chunk.MeshedVersion;
+    ReloadChunkDensity(Layout, Chunk.Coord, Chunk.Evicted.Get(), NewData->Density);
+
+    Chunk.Data = MoveTemp(NewData);
+    Chunk.Evicted.Reset();
+    bSnapshotStale = true;
+}
+
+// Function to rebuild an evicted edited chunk for a query, so it samples the edits rather than the
+// analytic density. Each snapshot rebuilds a chunk once, however many threads ask for it.
+const FPlanetChunkData* APlanetActor::ReloadSnapshotChunk(const FPlanetDensitySnapshot& Snapshot, int32 ChunkIndex) const
+{
+    const FPlanetEvictedDensity* Evicted = Snapshot.Evicted.IsValidIndex(ChunkIndex) ? Snapshot.Evicted[ChunkIndex].Get() : nullptr;
+    if (!Evicted || !Snapshot.Reloaded.IsValid())
+    {
+        return nullptr;
+    }
+
+    FPlanetReloadedChunks& Reloaded = *Snapshot.Reloaded;
+    {
+        FScopeLock Lock(&Reloaded.Lock);
+        if (const TSharedPtr<FPlanetChunkData, ESPMode::ThreadSafe>* Found = Reloaded.Chunks.Find(ChunkIndex))
+        {
+            return Found->Get();
+        }
+    }
+
+    // Rebuilt outside the lock so queries on other chunks don't wait. If two threads race, the first one's copy is kept.
+    TSharedPtr<FPlanetChunkData, ESPMode::ThreadSafe> NewData = MakeShared<FPlanetChunkData, ESPMode::ThreadSafe>();
+    NewData->Version = Evicted->Version;
+    ReloadChunkDensity(Snapshot.Layout, Snapshot.Layout.GetChunkCoord(ChunkIndex), Evicted, NewData->Density);
+
+    // Entries are never removed while the snapshot lives, so the pointer stays valid for the caller
+    FScopeLock Lock(&Reloaded.Lock);
+    return Reloaded.Chunks.FindOrAdd(ChunkIndex, MoveTemp(NewData)).Get();
+}
+
+// Function to keep the chunks queries rebuilt from the current snapshot, so the next one doesn't rebuild them again
+void APlanetActor::AdoptReloadedChunks()
+{
+    if (!DensitySnapshot->Reloaded.IsValid())
+    {
+        return;
+    }
+
+    const double Now = GetWorld()->GetTimeSeconds();
+    FPlanetReloadedChunks& Reloaded = *DensitySnapshot->Reloaded;
+    FScopeLock Lock(&Reloaded.Lock);
+
+    for (const TPair<int32, TSharedPtr<FPlanetChunkData, ESPMode::ThreadSafe>>& Pair : Reloaded.Chunks)
+    {
+        // Skip chunks that were reloaded or rebaked on the game thread since the snapshot was published
+        FPlanetChunk* Chunk = Chunks.IsValidIndex(Pair.Key) ? &Chunks[Pair.Key] : nullptr;
+        if (!Chunk || Chunk->Data.IsValid() || Chunk->Evicted != DensitySnapshot->Evicted[Pair.Key])
+        {
+            continue;
+        }
+
+        // Queried chunks count as viewed, so they aren't evicted again straight away
+        Chunk->Data = Pair.Value;
+        Chunk->Evicted.Reset();
+        Chunk->LastViewedTime = Now;
+        bSnapshotStale = true;
+    }
+}
+
+// Function to mark chunks near any player as viewed, and bring back evicted meshes they need
+void APlanetActor::UpdateChunkViewTimes()
+{
+    if (Chunks.Num() == 0)
+    {
+        return;
+    }
+
+    // The server sees every player's controller and clients only their own, which is what each needs resident
+    TArray<FVector, TInlineAllocator<4>> ViewLocations;
+    for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+    {
+        if (const APlayerController* PlayerController = It->Get())
+        {
+            FVector ViewLocation;
+            FRotator ViewRotation;
+            PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+            ViewLocations.Add(GetActorTransform().InverseTransformPosition(ViewLocation));
+        }
+    }
+
+    const double Now = GetWorld()->GetTimeSeconds();
+    const float ViewDistanceSquared = FMath::Square(ChunkViewDistance);
+
+    for (FPlanetChunk& Chunk : Chunks)
+    {
+        const FBox Bounds = Layout.GetChunkBounds(Chunk.Coord);
+        for (const FVector& ViewLocation : ViewLocations)
+        {
+            if (Bounds.ComputeSquaredDistanceToPoint(ViewLocation) <= ViewDistanceSquared)
+            {
+                Chunk.LastViewedTime = Now;
+                if (Chunk.bMeshEvicted)
+                {
+                    Chunk.bMeshEvicted = false;
+                    Chunk.MeshedVersion = FPlanetChunk::UnmeshedVersion;
+                }
+                break;
+            }
+        }
+    }
+}
+
+// Function to estimate what one mesh section costs, including its GPU buffers and collision
+SIZE_T APlanetActor::GetSectionMemory(int32 SectionIndex, SIZE_T& OutCollisionBytes) const
+{
+    // Position, packed tangent frame and UV per vertex, as unpacked by the scene proxy
+    const SIZE_T GPUBytesPerVertex = sizeof(FVector3f) + 8 + 4;
+
+    OutCollisionBytes = 0;
+    const FPlanetMeshSection* Section = PlanetMesh->GetChunkSection(SectionIndex);
+    if (!Section)
+    {
+        return 0;
+    }
+
+    OutCollisionBytes = Section->Vertices.Num() * sizeof(FVector3f) + Section->Indices.Num() * sizeof(uint32);
+    return Section->GetAllocatedSize() + Section->Vertices.Num() * GPUBytesPerVertex + Section->Indices.Num() * sizeof(uint32);
+}
+
+void APlanetActor::GetMemoryUsage(FPlanetMemoryUsage& OutUsage) const
+{
+    OutUsage = FPlanetMemoryUsage();
+    OutUsage.NumChunks = Chunks.Num();
+
+    for (const FPlanetChunk& Chunk : Chunks)
+    {
+        if (Chunk.Data.IsValid())
+        {
+            OutUsage.DensityBytes += Chunk.Data->Density.GetAllocatedSize();
+        }
+        else
+        {
+            OutUsage.NumDensityEvicted++;
+        }
+
+        if (Chunk.Evicted.IsValid())
+        {
+            OutUsage.BakedEditBytes += Chunk.Evicted->CompressedDelta.GetAllocatedSize();
+        }
+
+        OutUsage.NumMeshEvicted += Chunk.bMeshEvicted ? 1 : 0;
+    }
+
+    // Every machine keeps the replicated deltas for as long as the planet exists
+    OutUsage.BakedEditBytes += BakedEdits.Pieces.GetAllocatedSize();
+    for (const FPlanetBakedPiece& Piece : BakedEdits.Pieces)
+    {
+        OutUsage.BakedEditBytes += Piece.Data.GetAllocatedSize();
+    }
+
+    // Counts preview sections too, before the final pass has created any chunks
+    for (int32 SectionIndex = 0; SectionIndex < PlanetMesh->GetNumChunkSections(); SectionIndex++)
+    {
+        SIZE_T CollisionBytes;
+        OutUsage.MeshBytes += GetSectionMemory(SectionIndex, CollisionBytes);
+        OutUsage.CollisionBytes += CollisionBytes;
+    }
+}
+
+void APlanetActor::GetEvictionCandidates(double ViewedBefore, TArray<FPlanetEvictionCandidate>& OutCandidates)
+{
+    // A running mesh batch still holds its snapshot and expects its chunks untouched, so wait for it
+    if (bMeshTaskRunning)
+    {
+        return;
+    }
+
+    for (int32 ChunkIndex = 0; ChunkIndex < Chunks.Num(); ChunkIndex++)
+    {
+        const FPlanetChunk& Chunk = Chunks[ChunkIndex];
+
+        // Chunks waiting on a rebuild are skipped until their mesh catches up with their data
+        if (Chunk.LastViewedTime >= ViewedBefore || (Chunk.Data.IsValid() && Chunk.Data->Version != Chunk.MeshedVersion))
+        {
+            continue;
+        }
+
+        FPlanetEvictionCandidate Candidate;
+        Candidate.Planet = this;
+        Candidate.ChunkIndex = ChunkIndex;
+        Candidate.LastViewedTime = Chunk.LastViewedTime;
+
+        // Density edited since the last bake has no delta to be rebuilt from, so it stays until the next bake
+        if (Chunk.Data.IsValid() && !Chunk.bEditedSinceBake)
+        {
+            OutCandidates.Add(Candidate);
+        }
+
+        if (!Chunk.bMeshEvicted)
+        {
+            Candidate.bMesh = true;
+            OutCandidates.Add(Candidate);
+        }
+    }
+}
+
+// Function to free a chunk's density or mesh. Edited density keeps a copy of its compressed baked delta,
+// which is all it takes to rebuild it on top of the base density.
+SIZE_T APlanetActor::EvictChunk(int32 ChunkIndex, bool bMesh)
+{
+    if (!Chunks.IsValidIndex(ChunkIndex))
+    {
+        return 0;
+    }
+
+    FPlanetChunk& Chunk = Chunks[ChunkIndex];
+
+    if (bMesh)
+    {
+        if (Chunk.bMeshEvicted)
+        {
+            return 0;
+        }
+
+        SIZE_T CollisionBytes;
+        const SIZE_T MeshBytes = GetSectionMemory(ChunkIndex, CollisionBytes);
+        PlanetMesh->ClearChunkSection(ChunkIndex);
+
+        const int32 NumRules = ScatterRules.Num();
+        for (int32 RuleIndex = 0; RuleIndex < NumRules; RuleIndex++)
+        {
+            const int32 ComponentIndex = ChunkIndex * NumRules + RuleIndex;
+            if (ScatterComponents.IsValidIndex(ComponentIndex) && ScatterComponents[ComponentIndex])
+            {
+                ScatterComponents[ComponentIndex]->ClearInstances();
+            }
+        }
+
+        Chunk.bMeshEvicted = true;
+        bCollisionStale = true;
+        return MeshBytes + CollisionBytes;
+    }
+
+    if (!Chunk.Data.IsValid() || Chunk.bEditedSinceBake)
+    {
+        return 0;
+    }
+
+    SIZE_T FreedBytes = Chunk.Data->Density.GetAllocatedSize();
+
+    if (Chunk.bEdited)
+    {
+        // On clients the pieces of a newer bake may still be arriving, so wait until the delta matches the data
+        TSharedPtr<FPlanetEvictedDensity, ESPMode::ThreadSafe> NewEvicted = MakeShared<FPlanetEvictedDensity, ESPMode::ThreadSafe>();
+        uint32 Sequence = 0;
+        if (!BakedEdits.GetCompressedChunkDelta(ChunkIndex, Sequence, NewEvicted->CompressedDelta) || Sequence != Chunk.BakedSequence)
+        {
+            return 0;
+        }
+
+        NewEvicted->Version = Chunk.Data->Version;
+        FreedBytes -= FMath::Min(FreedBytes, static_cast<SIZE_T>(NewEvicted->CompressedDelta.GetAllocatedSize()));
+        Chunk.Evicted = MoveTemp(NewEvicted);
+    }
+
+    Chunk.Data.Reset();
+    bSnapshotStale = true;
+    return FreedBytes;
+}
+
+// Function to generate the planet
+void APlanetActor::GeneratePlanet()
+{
+    // Perlin noise repeats every 256 units, so any offset within one period is a new planet
+    const FRandomStream SeedStream(NoiseSeed);
+    NoiseOffset = NoiseSeed == 0 ? FVector::ZeroVector : FVector(SeedStream.FRandRange(0, 256), SeedStream.FRandRange(0, 256), SeedStream.FRandRange(0, 256));
+
+    // Progressive planets bake in the background instead of holding up the first pass
+    if (bUseNoiseVolume && !bProgressiveGeneration)
+    {
+        NoiseVolume = BakeNoiseVolume();
+        bNoiseVolumeBaked = true;
+    }
+
+    bSnapshotStale = true;
+    PublishDensitySnapshot();
+
+    // Optional: Apply the material (if already set in the blueprint or elsewhere)
+    if (PlanetMaterial)
+    {
+        PlanetMesh->SetMaterial(0, PlanetMaterial);
+    }
+
+    // Queue every pass from coarse up to the configured detail, doubling the resolution each time
+    PendingPassGridSizes.Reset();
+    if (bProgressiveGeneration)
+    {
+        for (int32 PassGridSize = ProgressiveStartGridSize; PassGridSize < GridSize; PassGridSize *= 2)
+        {
+            PendingPassGridSizes.Add(PassGridSize);
+        }
+    }
+    PendingPassGridSizes.Add(GridSize);
+
+    // Build the first pass on the game thread so there's something on screen straight away
+    FPlanetGenerationPass FirstPass;
+    BuildGenerationPass(PendingPassGridSizes[0], FirstPass);
+    PendingPassGridSizes.RemoveAt(0);
+    ApplyGenerationPass(FirstPass);
+
+    StartNextGenerationPass();
+}
+
+// Function to work out how a grid of PassGridSize cells is split into chunks. Chunk samples are stored
+// in Morton order, so chunks are a power of two cells across, no bigger than ChunkSize. The largest
+// one that tiles the pass exactly is used, so a pass never samples more cells than it asked for, unless
+// that's under half the largest that fits and would multiply the section count. Then the grid is
+// padded by less than one chunk instead.
+FPlanetGridLayout APlanetActor::MakeLayout(int32 PassGridSize) const
+{
+    const int32 LargestChunk = 1 << FMath::FloorLog2(static_cast<uint32>(FMath::Max(FMath::Min(ChunkSize, PassGridSize), 1)));
+    const int32 TilingChunk = FMath::Min(LargestChunk, PassGridSize & -PassGridSize);
+
+    FPlanetGridLayout PassLayout;
+    PassLayout.ChunkSize = TilingChunk * 2 >= LargestChunk ? TilingChunk : LargestChunk;
+    PassLayout.ChunksPerAxis = FMath::DivideAndRoundUp(PassGridSize, PassLayout.ChunkSize);
+    PassLayout.VoxelSize = VoxelSize * GridSize / static_cast<float>(PassGridSize);
+    return PassLayout;
+}
+
+// Function to sample and polygonise a whole planet at one resolution. Safe to call off the game thread.
+void APlanetActor::BuildGenerationPass(int32 PassGridSize, FPlanetGenerationPass& OutPass) const
+{
+    const double StartTime = FPlatformTime::Seconds();
+
+    // Every pass spans the same space as the final grid, just with bigger voxels
+    OutPass.GridSize = PassGridSize;
+    OutPass.bFinal = PassGridSize >= GridSize;
+    OutPass.Layout = MakeLayout(PassGridSize);
+
+    const int32 NumChunks = OutPass.Layout.GetNumChunks();
+    OutPass.Chunks.SetNum(NumChunks);
+    OutPass.Sections.SetNum(NumChunks);
+
+    ParallelFor(NumChunks, [&OutPass, this](int32 ChunkIndex)
+    {
+        // A cancelled pass is thrown away, so the rest of its chunks can be skipped
+        if (bGenerationCancelled)
+        {
+            return;
+        }
+
+        FPlanetChunk& Chunk = OutPass.Chunks[ChunkIndex];
+        Chunk.Coord = OutPass.Layout.GetChunkCoord(ChunkIndex);
+        Chunk.Data = MakeShared<FPlanetChunkData, ESPMode::ThreadSafe>();
+        AssignDensityValues(OutPass.Layout, Chunk.Coord, Chunk.Data->Density);
+    });
+
+    if (bGenerationCancelled)
+    {
+        return;
+    }
+
+    // Normals sample neighbouring chunks, so only polygonise once every chunk has its density
+    FPlanetDensitySnapshot PassSnapshot;
+    PassSnapshot.Layout = OutPass.Layout;
+    PassSnapshot.SetChunks(OutPass.Chunks);
+    PassSnapshot.NoiseVolume = NoiseVolume;
+
+    const bool bScatter = OutPass.bFinal && ScatterRules.Num() > 0;
+    if (bScatter)
+    {
+        OutPass.Scatter.SetNum(NumChunks);
+    }
+
+    ParallelFor(NumChunks, [&OutPass, &PassSnapshot, bScatter, this](int32 ChunkIndex)
+    {
+        if (bGenerationCancelled)
+        {
+            return;
+        }
+
+        PolygoniseChunk(PassSnapshot, ChunkIndex, OutPass.Sections[ChunkIndex]);
+
+        if (bScatter)
+        {
+            FPlanetScatter::ScatterSection(OutPass.Sections[ChunkIndex], ScatterRules, Radius, NoiseSeed, OutPass.Scatter[ChunkIndex]);
+        }
+    });
+
+    OutPass.BuildSeconds = FPlatformTime::Seconds() - StartTime;
+}
+
+// Function to swap a finished pass onto the mesh, and adopt the final pass as the editable field
+void APlanetActor::ApplyGenerationPass(FPlanetGenerationPass& Pass)
+{
+    UE_LOG(LogPlanet, Log, TEXT("%s: %d^3 pass built in %.1f ms"), *GetName(), Pass.GridSize, Pass.BuildSeconds * 1000.0);
+
+    const int32 OldNumSections = PlanetMesh->GetNumChunkSections();
+    for (int32 SectionIndex = 0; SectionIndex < Pass.Sections.Num(); SectionIndex++)
+    {
+        PlanetMesh->SetChunkSection(SectionIndex, MoveTemp(Pass.Sections[SectionIndex]));
+    }
+    for (int32 SectionIndex = Pass.Sections.Num(); SectionIndex < OldNumSections; SectionIndex++)
+    {
+        PlanetMesh->ClearChunkSection(SectionIndex);
+    }
+
+    if (Pass.bFinal)
+    {
+        // The pass's sections were built from these exact versions, so they start out clean
+        Layout = Pass.Layout;
+        Chunks = MoveTemp(Pass.Chunks);
+        bSnapshotStale = true;
+
+        for (int32 ChunkIndex = 0; ChunkIndex < Pass.Scatter.Num(); ChunkIndex++)
+        {
+            ApplyChunkScatter(ChunkIndex, Pass.Scatter[ChunkIndex]);
+        }
+
+        // Edits that arrived while the planet was still generating are replayed on the fresh field
+        AppliedSequence = 0;
+        for (int32 ChunkIndex = 0; ChunkIndex < Chunks.Num(); ChunkIndex++)
+        {
+            RefreshBakedChunk(ChunkIndex);
+        }
+        ApplyPendingBrushOps();
+        PublishDensitySnapshot();
+    }
+
+    CookCollision();
+}
+
+// Function to find or bake the noise volume covering this planet's grid in noise space
+TSharedPtr<const FPlanetNoiseVolume, ESPMode::ThreadSafe> APlanetActor::BakeNoiseVolume() const
+{
+    const FPlanetGridLayout FinalLayout = MakeLayout(GridSize);
+    const float HalfExtent = FinalLayout.ChunksPerAxis * FinalLayout.ChunkSize * FinalLayout.VoxelSize * 0.5f;
+    const FVector NoiseMin = FVector(-HalfExtent) * NoiseScale + NoiseOffset;
+    const FVector NoiseMax = FVector(HalfExtent) * NoiseScale + NoiseOffset;
+
+    return FPlanetNoiseVolume::FindOrBake(NoiseMin.ComponentMin(NoiseMax), NoiseMin.ComponentMax(NoiseMax), NoiseVolumeResolution);
+}
+
+// Function to build the next queued pass on a worker thread
+void APlanetActor::StartNextGenerationPass()
+{
+    if (PendingPassGridSizes.Num() == 0 || bGenerationCancelled)
+    {
+        return;
+    }
+
+    TWeakObjectPtr<APlanetActor> WeakThis(this);
+
+    // Bake the noise volume before the remaining passes so they can all use it
+    if (bUseNoiseVolume && !bNoiseVolumeBaked)
+    {
+        GenerationTask = Async(EAsyncExecution::ThreadPool, [this, WeakThis]()
+        {
+            TSharedPtr<const FPlanetNoiseVolume, ESPMode::ThreadSafe> BakedVolume = BakeNoiseVolume();
+
+            AsyncTask(ENamedThreads::GameThread, [WeakThis, BakedVolume]()
+            {
+                APlanetActor* Planet = WeakThis.Get();
+                if (Planet && !Planet->bGenerationCancelled)
+                {
+                    Planet->NoiseVolume = BakedVolume;
+                    Planet->bNoiseVolumeBaked = true;
+                    Planet->bSnapshotStale = true;
+                    Planet->PublishDensitySnapshot();
+                    Planet->StartNextGenerationPass();
+                }
+            });
+        });
+        return;
+    }
+
+    const int32 PassGridSize = PendingPassGridSizes[0];
+    PendingPassGridSizes.RemoveAt(0);
+
+    GenerationTask = Async(EAsyncExecution::ThreadPool, [this, WeakThis, PassGridSize]()
+    {
+        TSharedPtr<FPlanetGenerationPass, ESPMode::ThreadSafe> Pass = MakeShared<FPlanetGenerationPass, ESPMode::ThreadSafe>();
+        BuildGenerationPass(PassGridSize, *Pass);
+
+        // Swap the pass in on the game thread, then kick off the next one
+        AsyncTask(ENamedThreads::GameThread, [WeakThis, Pass]()
+        {
+            APlanetActor* Planet = WeakThis.Get();
+            if (Planet && !Planet->bGenerationCancelled)
+            {
+                Planet->ApplyGenerationPass(*Pass);
+                Planet->StartNextGenerationPass();
+            }
+        });
+    });
+}
+
+// Function to record a brush edit on the server and add it to the replicated log
+void APlanetActor::ApplyBrush(const FVector& WorldLocation, float BrushRadius, float Strength, EPlanetBrushMode Mode)
+{
+    if (!HasAuthority())
+    {
+        return;
+    }
+
+    // Brush sizes come straight from client RPCs, so never trust them beyond the planet's limits
+    if (!FMath::IsFinite(BrushRadius) || !FMath::IsFinite(Strength) || BrushRadius <= 0.0f)
+    {
+        return;
+    }
+    BrushRadius = FMath::Min(BrushRadius, FMath::Max(MaxBrushRadius, 1.0f));
+    Strength = FMath::Clamp(Strength, 0.0f, FMath::Max(MaxBrushStrength, 0.0f));
+
+    // Quantise everything up front so the server applies exactly what clients will replay
+    const FVector LocalLocation = GetActorTransform().InverseTransformPosition(WorldLocation);
+
+    FPlanetBrushOp& Op = EditLog.Ops.AddDefaulted_GetRef();
+    Op.Sequence = ++IssuedSequence;
+    Op.Center = FVector(FMath::RoundToDouble(LocalLocation.X), FMath::RoundToDouble(LocalLocation.Y), FMath::RoundToDouble(LocalLocation.Z));
+    Op.Radius = static_cast<uint16>(FMath::Clamp(FMath::RoundToInt(BrushRadius), 0, static_cast<int32>(MAX_uint16)));
+    Op.Strength = static_cast<uint16>(FMath::Clamp(FMath::RoundToInt(Strength), 0, static_cast<int32>(MAX_uint16)));
+    Op.Mode = Mode;
+    EditLog.MarkItemDirty(Op);
+
+    // Applies straight away, or once the full resolution field exists if the planet is still generating
+    ApplyPendingBrushOps();
+
+    if (Chunks.Num() > 0 && EditLog.Ops.Num() >= MaxEditLogOps)
+    {
+        CompactEditLog();
+    }
+
+    PublishDensitySnapshot();
+}
+
+// Function to apply a brush op to every chunk it overlaps
+void APlanetActor::ApplyBrushOp(const FPlanetBrushOp& Op)
+{
+    const FBox OpBounds = Op.GetBounds();
+
+    for (FPlanetChunk& Chunk : Chunks)
+    {
+        // Chunks whose baked delta already contains this op must not apply it twice
+        if (Chunk.BakedSequence >= Op.Sequence)
+        {
+            continue;
+        }
+
+        if (Layout.GetChunkBounds(Chunk.Coord).Intersect(OpBounds))
+        {
+            ApplyBrushOpToChunk(Op, Chunk);
+        }
+    }
+}
+
+// Function to apply a brush op to the samples of one chunk
+void APlanetActor::ApplyBrushOpToChunk(const FPlanetBrushOp& Op, FPlanetChunk& Chunk)
+{
+    const int32 CellsPerAxis = Layout.ChunkSize;
+    const float Spacing = Layout.VoxelSize;
+    const FBox OpBounds = Op.GetBounds();
+    const FVector ChunkOrigin = Layout.GetSamplePosition(Chunk.Coord, 0, 0, 0);
+
+    // Only visit the samples inside the brush bounds
+    const FIntVector Min(
+        FMath::Clamp(FMath::FloorToInt((OpBounds.Min.X - ChunkOrigin.X) / Spacing), 0, CellsPerAxis),
+        FMath::Clamp(FMath::FloorToInt((OpBounds.Min.Y - ChunkOrigin.Y) / Spacing), 0, CellsPerAxis),
+        FMath::Clamp(FMath::FloorToInt((OpBounds.Min.Z - ChunkOrigin.Z) / Spacing), 0, CellsPerAxis));
+    const FIntVector Max(
+        FMath::Clamp(FMath::CeilToInt((OpBounds.Max.X - ChunkOrigin.X) / Spacing), 0, CellsPerAxis),
+        FMath::Clamp(FMath::CeilToInt((OpBounds.Max.Y - ChunkOrigin.Y) / Spacing), 0, CellsPerAxis),
+        FMath::Clamp(FMath::CeilToInt((OpBounds.Max.Z - ChunkOrigin.Z) / Spacing), 0, CellsPerAxis));
+
+    FPlanetChunkData& Data = EditChunkData(Chunk);
+
+    for (int z = Min.Z; z <= Max.Z; z++)
+    {
+        for (int y = Min.Y; y <= Max.Y; y++)
+        {
+            for (int x = Min.X; x <= Max.X; x++)
+            {
+                float& Density = Data.Density[FPlanetChunk::SampleIndex(x, y, z, CellsPerAxis)];
+                Density = Op.Apply(Layout.GetSamplePosition(Chunk.Coord, x, y, z), Density);
+            }
+        }
+    }
+
+    Chunk.bEdited = true;
+    Chunk.bEditedSinceBake = true;
+}
+
+// Function to apply replicated ops strictly in sequence order, waiting on any gaps
+void APlanetActor::ApplyPendingBrushOps()
+{
+    if (Chunks.Num() == 0)
+    {
+        return;
+    }
+
+    // Ops folded into the baked snapshot arrive as chunk deltas instead
+    AppliedSequence = FMath::Max(AppliedSequence, BakedSequence);
+
+    while (const FPlanetBrushOp* Op = EditLog.FindOp(AppliedSequence + 1))
+    {
+        ApplyBrushOp(*Op);
+        AppliedSequence = Op->Sequence;
+    }
+}
+
+// Function to rebuild a chunk from its baked delta and replay the ops that came after it
+void APlanetActor::RefreshBakedChunk(int32 ChunkIndex)
+{
+    if (!Chunks.IsValidIndex(ChunkIndex))
+    {
+        return;
+    }
+
+    FPlanetChunk& Chunk = Chunks[ChunkIndex];
+
+    uint32 Sequence = 0;
+    TArray<int16> QuantisedDelta;
+    const int32 SamplesPerAxis = Layout.ChunkSize + 1;
+    if (!BakedEdits.GetChunkDelta(ChunkIndex, SamplesPerAxis * SamplesPerAxis * SamplesPerAxis, Sequence, QuantisedDelta) || Sequence <= Chunk.BakedSequence)
+    {
+        return;
+    }
+
+    // Every sample is replaced, so build a fresh version rather than copying or reloading the old one
+    TSharedPtr<FPlanetChunkData, ESPMode::ThreadSafe> NewData = MakeShared<FPlanetChunkData, ESPMode::ThreadSafe>();
+    NewData->Version = (Chunk.Data.IsValid() ? Chunk.Data->Version : Chunk.MeshedVersion) + 1;
+    AssignDensityValues(Layout, Chunk.Coord, NewData->Density);
+    AddBakedDelta(QuantisedDelta, NewData->Density);
+
+    // Matches the bake now, until the replay below applies anything newer
+    Chunk.Data = MoveTemp(NewData);
+    Chunk.Evicted.Reset();
+    Chunk.BakedSequence = Sequence;
+    Chunk.bEdited = true;
+    Chunk.bEditedSinceBake = false;
+    bSnapshotStale = true;
+
+    // Later ops were applied on top of the old state, so apply them again on top of the new one
+    for (uint32 OpSequence = Sequence + 1; OpSequence <= AppliedSequence; OpSequence++)
+    {
+        if (const FPlanetBrushOp* Op = EditLog.FindOp(OpSequence))
+        {
+            if (Op->GetBounds().Intersect(Layout.GetChunkBounds(Chunk.Coord)))
+            {
+                ApplyBrushOpToChunk(*Op, Chunk);
+            }
+        }
+    }
+}
+
+// Function to bake the whole log into per-chunk deltas so late joiners don't need every op
+void APlanetActor::CompactEditLog()
+{
+    const uint32 Sequence = AppliedSequence;
+    bool bBakeFailed = false;
+
+    for (int32 ChunkIndex = 0; ChunkIndex < Chunks.Num(); ChunkIndex++)
+    {
+        FPlanetChunk& Chunk = Chunks[ChunkIndex];
+        if (!Chunk.bEditedSinceBake)
+        {
+            continue;
+        }
+
+        EnsureChunkResident(Chunk);
+
+        const TArray<float>& EditedDensity = Chunk.Data->Density;
+        TSharedPtr<FPlanetChunkData, ESPMode::ThreadSafe> NewData = MakeShared<FPlanetChunkData, ESPMode::ThreadSafe>();
+        NewData->Version = Chunk.Data->Version + 1;
+        AssignDensityValues(Layout, Chunk.Coord, NewData->Density);
+
+        TArray<int16> QuantisedDelta;
+        QuantisedDelta.SetNumUninitialized(NewData->Density.Num());
+        for (int32 SampleIndex = 0; SampleIndex < NewData->Density.Num(); SampleIndex++)
+        {
+            const float Delta = (EditedDensity[SampleIndex] - NewData->Density[SampleIndex]) / FPlanetBakedEdits::DeltaQuantum;
+            QuantisedDelta[SampleIndex] = static_cast<int16>(FMath::Clamp(FMath::RoundToInt(Delta), static_cast<int32>(MIN_int16), static_cast<int32>(MAX_int16)));
+
+            // Keep the server on the quantised values too, so it matches what late joiners rebuild
+            NewData->Density[SampleIndex] += QuantisedDelta[SampleIndex] * FPlanetBakedEdits::DeltaQuantum;
+        }
+
+        // A chunk that can't be baked keeps its exact density and stays in the log for everyone to replay
+        if (!BakedEdits.SetChunkDelta(ChunkIndex, Sequence, QuantisedDelta))
+        {
+            UE_LOG(LogPlanet, Error, TEXT("%s: failed to bake edits for chunk (%d, %d, %d), keeping the edit log"), *GetName(), Chunk.Coord.X, Chunk.Coord.Y, Chunk.Coord.Z);
+            bBakeFailed = true;
+            continue;
+        }
+
+        Chunk.Data = MoveTemp(NewData);
+        Chunk.BakedSequence = Sequence;
+        Chunk.bEditedSinceBake = false;
+        bSnapshotStale = true;
+    }
+
+    // Chunks that did bake skip the ops they hold, so keeping the whole log is safe for them and late joiners
+    if (bBakeFailed)
+    {
+        return;
+    }
+
+    BakedSequence = Sequence;
+    EditLog.Ops.Reset();
+    EditLog.MarkArrayDirty();
+}
+
+void APlanetActor::HandleReplicatedBrushOp(const FPlanetBrushOp& Op)
+{
+    ApplyPendingBrushOps();
+    PublishDensitySnapshot();
+}
+
+void APlanetActor::HandleReplicatedBakedPiece(const FPlanetBakedPiece& Piece)
+{
+    RefreshBakedChunk(Piece.ChunkIndex);
+    PublishDensitySnapshot();
+}
+
+void APlanetActor::OnRep_BakedSequence()
+{
+    ApplyPendingBrushOps();
+    PublishDensitySnapshot();
+}
+
+// Function to sample a snapshot at a planet-local position
+float APlanetActor::SampleDensityLocal(const FPlanetDensitySnapshot& Snapshot, const FVector& LocalPosition) const
+{
+    int32 ChunkIndex;
+    FIntVector Local;
+    FVector Alpha;
+    if (Snapshot.FindCell(LocalPosition, ChunkIndex, Local, Alpha))
+    {
+        // The analytic density doesn't have an evicted chunk's edits, so edited ones are rebuilt first
+        const FPlanetChunkData* Chunk = Snapshot.Chunks[ChunkIndex].Get();
+        if (!Chunk)
+        {
+            Chunk = ReloadSnapshotChunk(Snapshot, ChunkIndex);
+        }
+        if (Chunk)
+        {
+            return Snapshot.SampleChunk(*Chunk, Local, Alpha);
+        }
+    }
+
+    // Outside the grid nothing can have been edited, and evicted unedited chunks regenerate to the same field
+    return SampleBaseDensity(LocalPosition, Snapshot.NoiseVolume.Get());
+}
+
+// Function to estimate the density gradient with central differences
+FVector APlanetActor::SampleGradientLocal(const FPlanetDensitySnapshot& Snapshot, const FVector& LocalPosition) const
+{
+    const float H = Snapshot.Layout.VoxelSize * 0.5f;
+
+    return FVector(
+        SampleDensityLocal(Snapshot, LocalPosition + FVector(H, 0, 0)) - SampleDensityLocal(Snapshot, LocalPosition - FVector(H, 0, 0)),
+        SampleDensityLocal(Snapshot, LocalPosition + FVector(0, H, 0)) - SampleDensityLocal(Snapshot, LocalPosition - FVector(0, H, 0)),
+        SampleDensityLocal(Snapshot, LocalPosition + FVector(0, 0, H)) - SampleDensityLocal(Snapshot, LocalPosition - FVector(0, 0, H))) / (2.0f * H);
+}
+
+// Function to project a point onto the surface with Newton steps along the gradient
+bool APlanetActor::FindClosestSurfacePointLocal(const FPlanetDensitySnapshot& Snapshot, const FVector& LocalPosition, FVector& OutSurfacePoint) const
+{
+    const float Tolerance = Snapshot.Layout.VoxelSize * 0.01f;
+    const int MaxIterations = 16;
+
+    FVector Position = LocalPosition;
+    for (int Iteration = 0; Iteration < MaxIterations; Iteration++)
+    {
+        const float Density = SampleDensityLocal(Snapshot, Position);
+        if (FMath::Abs(Density) <= Tolerance)
+        {
+            OutSurfacePoint = Position;
+            return true;
+        }
+
+        const FVector Gradient = SampleGradientLocal(Snapshot, Position);
+        const float GradientSizeSquared = Gradient.SizeSquared();
+        if (GradientSizeSquared < UE_SMALL_NUMBER)
+        {
+            break;
+        }
+
+        // Clamp the step so a noisy gradient can't throw the point across the planet
+        const FVector Step = Gradient * (Density / GradientSizeSquared);
+        Position -= Step.GetClampedToMaxSize(Snapshot.Layout.VoxelSize * 4.0f);
+    }
+
+    OutSurfacePoint = Position;
+    return false;
+}
+
+// Function to sphere trace the density field, then bisect the first outside-to-inside crossing
+bool APlanetActor::RaycastLocal(const FPlanetDensitySnapshot& Snapshot, const FVector& LocalStart, const FVector& LocalDirection, float MaxDistance, FVector& OutHitPosition) const
+{
+    float PreviousDensity = SampleDensityLocal(Snapshot, LocalStart);
+    if (PreviousDensity > 0)
+    {
+        // Starting inside the planet counts as an immediate hit
+        OutHitPosition = LocalStart;
+        return true;
+    }
+
+    // Density isn't a true distance field, so never step less than a fraction of a voxel
+    const float MinStep = Snapshot.Layout.VoxelSize * 0.25f;
+
+    float PreviousT = 0.0f;
+    while (PreviousT < MaxDistance)
+    {
+        const float Step = FMath::Max(FMath::Abs(PreviousDensity) / DensityLipschitz, MinStep);
+        const float T = FMath::Min(PreviousT + Step, MaxDistance);
+        const float Density = SampleDensityLocal(Snapshot, LocalStart + LocalDirection * T);
+
+        if (Density > 0)
+        {
+            float Outside = PreviousT;
+            float Inside = T;
+            for (int Iteration = 0; Iteration < 12; Iteration++)
+            {
+                const float Mid = (Outside + Inside) * 0.5f;
+                if (SampleDensityLocal(Snapshot, LocalStart + LocalDirection * Mid) > 0)
+                {
+                    Inside = Mid;
+                }
+                else
+                {
+                    Outside = Mid;
+                }
+            }
+
+            OutHitPosition = LocalStart + LocalDirection * Inside;
+            return true;
+        }
+
+        PreviousT = T;
+        PreviousDensity = Density;
+    }
+
+    return false;
+}
+
+float APlanetActor::SampleDensity(const FVector& WorldLocation) const
+{
+    const TSharedPtr<const FPlanetDensitySnapshot, ESPMode::ThreadSafe> Snapshot = GetDensitySnapshot();
+    return SampleDensityLocal(*Snapshot, Snapshot->Transform.InverseTransformPosition(WorldLocation));
+}
+
+FVector APlanetActor::SampleGradient(const FVector& WorldLocation) const
+{
+    const TSharedPtr<const FPlanetDensitySnapshot, ESPMode::ThreadSafe> Snapshot = GetDensitySnapshot();
+    const FTransform& Transform = Snapshot->Transform;
+    return Transform.TransformVectorNoScale(SampleGradientLocal(*Snapshot, Transform.InverseTransformPosition(WorldLocation)));
+}
+
+FVector APlanetActor::GetSurfaceNormal(const FVector& WorldLocation) const
+{
+    return (-SampleGradient(WorldLocation)).GetSafeNormal();
+}
+
+bool APlanetActor::FindClosestSurfacePoint(const FVector& WorldLocation, FVector& OutSurfacePoint) const
+{
+    const TSharedPtr<const FPlanetDensitySnapshot, ESPMode::ThreadSafe> Snapshot = GetDensitySnapshot();
+    const FTransform& Transform = Snapshot->Transform;
+
+    FVector LocalSurfacePoint;
+    const bool bConverged = FindClosestSurfacePointLocal(*Snapshot, Transform.InverseTransformPosition(WorldLocation), LocalSurfacePoint);
+    OutSurfacePoint = Transform.TransformPosition(LocalSurfacePoint);
+    return bConverged;
+}
+
+bool APlanetActor::Raycast(const FVector& Start, const FVector& Direction, float MaxDistance, FPlanetRayHit& OutHit) const
+{
+    const TSharedPtr<const FPlanetDensitySnapshot, ESPMode::ThreadSafe> Snapshot = GetDensitySnapshot();
+    const FTransform& Transform = Snapshot->Transform;
+
+    // Trace in local space, scaling the distance by however much the transform shrinks the direction
+    const FVector LocalStart = Transform.InverseTransformPosition(Start);
+    const FVector LocalDirection = Transform.InverseTransformVector(Direction.GetSafeNormal());
+    const float LocalScale = LocalDirection.Size();
+
+    OutHit = FPlanetRayHit();
+
+    FVector LocalHit;
+    if (LocalScale < UE_SMALL_NUMBER || !RaycastLocal(*Snapshot, LocalStart, LocalDirection / LocalScale, MaxDistance * LocalScale, LocalHit))
+    {
+        return false;
+    }
+
+    OutHit.bHit = true;
+    OutHit.Location = Transform.TransformPosition(LocalHit);
+    OutHit.Normal = Transform.TransformVectorNoScale(-SampleGradientLocal(*Snapshot, LocalHit)).GetSafeNormal();
+    OutHit.Distance = FVector::Dist(Start, OutHit.Location);
+    return true;
+}
+
+FVector APlanetActor::GetGravityDirection(const FVector& WorldLocation) const
+{
+    return (GetDensitySnapshot()->Transform.GetLocation() - WorldLocation).GetSafeNormal();
+}
+
+float APlanetActor::GetAltitude(const FVector& WorldLocation) const
+{
+    const TSharedPtr<const FPlanetDensitySnapshot, ESPMode::ThreadSafe> Snapshot = GetDensitySnapshot();
+    const FTransform& Transform = Snapshot->Transform;
+
+    const FVector LocalPosition = Transform.InverseTransformPosition(WorldLocation);
+    const FVector Up = LocalPosition.GetSafeNormal();
+
+    // Trace down the radial line from outside the grid so points above and below ground both work
+    const FPlanetGridLayout FinalLayout = MakeLayout(GridSize);
+    const float OuterRadius = FinalLayout.ChunksPerAxis * FinalLayout.ChunkSize * FinalLayout.VoxelSize;
+    FVector LocalSurface;
+    if (Up.IsZero() || !RaycastLocal(*Snapshot, Up * OuterRadius, -Up, OuterRadius, LocalSurface))
+    {
+        return LocalPosition.Size() * Transform.GetMaximumAxisScale();
+    }
+
+    return (LocalPosition.Size() - LocalSurface.Size()) * Transform.GetMaximumAxisScale();
+}
+
+void APlanetActor::SampleDensityBatch(TArrayView<const FVector> WorldLocations, TArrayView<float> OutDensities) const
+{
+    check(WorldLocations.Num() == OutDensities.Num());
+    const TSharedPtr<const FPlanetDensitySnapshot, ESPMode::ThreadSafe> Snapshot = GetDensitySnapshot();
+    const FTransform& Transform = Snapshot->Transform;
+
+    ParallelFor(WorldLocations.Num(), [&](int32 Index)
+    {
+        OutDensities[Index] = SampleDensityLocal(*Snapshot, Transform.InverseTransformPosition(WorldLocations[Index]));
+    });
+}
+
+void APlanetActor::SampleGradientBatch(TArrayView<const FVector> WorldLocations, TArrayView<FVector> OutGradients) const
+{
+    check(WorldLocations.Num() == OutGradients.Num());
+    const TSharedPtr<const FPlanetDensitySnapshot, ESPMode::ThreadSafe> Snapshot = GetDensitySnapshot();
+    const FTransform& Transform = Snapshot->Transform;
+
+    ParallelFor(WorldLocations.Num(), [&](int32 Index)
+    {
+        OutGradients[Index] = Transform.TransformVectorNoScale(SampleGradientLocal(*Snapshot, Transform.InverseTransformPosition(WorldLocations[Index])));
+    });
+}
+
+void APlanetActor::FindClosestSurfacePointBatch(TArrayView<const FVector> WorldLocations, TArrayView<FVector> OutSurfacePoints, TArrayView<bool> OutConverged) const
+{
+    check(WorldLocations.Num() == OutSurfacePoints.Num() && WorldLocations.Num() == OutConverged.Num());
+    const TSharedPtr<const FPlanetDensitySnapshot, ESPMode::ThreadSafe> Snapshot = GetDensitySnapshot();
+    const FTransform& Transform = Snapshot->Transform;
+
+    ParallelFor(WorldLocations.Num(), [&](int32 Index)
+    {
+        FVector LocalSurfacePoint;
+        OutConverged[Index] = FindClosestSurfacePointLocal(*Snapshot, Transform.InverseTransformPosition(WorldLocations[Index]), LocalSurfacePoint);
+        OutSurfacePoints[Index] = Transform.TransformPosition(LocalSurfacePoint);
+    });
+}
+
+void APlanetActor::RaycastBatch(TArrayView<const FVector> Starts, TArrayView<const FVector> Directions, float MaxDistance, TArrayView<FPlanetRayHit> OutHits) const
+{
+    check(Starts.Num() == Directions.Num() && Starts.Num() == OutHits.Num());
+    const TSharedPtr<const FPlanetDensitySnapshot, ESPMode::ThreadSafe> Snapshot = GetDensitySnapshot();
+    const FTransform& Transform = Snapshot->Transform;
+
+    ParallelFor(Starts.Num(), [&](int32 Index)
+    {
+        const FVector LocalStart = Transform.InverseTransformPosition(Starts[Index]);
+        const FVector LocalDirection = Transform.InverseTransformVector(Directions[Index].GetSafeNormal());
+        const float LocalScale = LocalDirection.Size();
+
+        FPlanetRayHit& Hit = OutHits[Index];
+        Hit = FPlanetRayHit();
+
+        FVector LocalHit;
+        if (LocalScale >= UE_SMALL_NUMBER && RaycastLocal(*Snapshot, LocalStart, LocalDirection / LocalScale, MaxDistance * LocalScale, LocalHit))
+        {
+            Hit.bHit = true;
+            Hit.Location = Transform.TransformPosition(LocalHit);
+            Hit.Normal = Transform.TransformVectorNoScale(-SampleGradientLocal(*Snapshot, LocalHit)).GetSafeNormal();
+            Hit.Distance = FVector::Dist(Starts[Index], Hit.Location);
+        }
+    });
+}
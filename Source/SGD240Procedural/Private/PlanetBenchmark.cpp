@@ -0,0 +1,219 @@
+#include "PlanetActor.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+
+static FAutoConsoleCommandWithWorldAndArgs PlanetBenchmarkMeshingCommand(
+    TEXT("planet.BenchmarkMeshing"),
+    TEXT("Times meshing and sampling each planet's resident chunks against the old linear-order code. Optional argument: iterations (default 4)"),
+    FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+    {
+        if (!World)
+        {
+            return;
+        }
+
+        const int32 Iterations = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 4;
+        for (TActorIterator<APlanetActor> It(World); It; ++It)
+        {
+            It->RunMeshingBenchmark(Iterations, *GLog);
+        }
+    }));
+
+// Function to time the slice walk against the per-voxel walk, and the Morton-order sampler against
+// the same sampler over row-major copies of the chunks. Runs on the game thread and blocks it.
+void APlanetActor::RunMeshingBenchmark(int32 Iterations, FOutputDevice& Ar) const
+{
+    const TSharedPtr<const FPlanetDensitySnapshot, ESPMode::ThreadSafe> Snapshot = GetDensitySnapshot();
+    const FPlanetGridLayout& SnapshotLayout = Snapshot->Layout;
+
+    TArray<int32> ResidentChunks;
+    for (int32 ChunkIndex = 0; ChunkIndex < Snapshot->Chunks.Num(); ChunkIndex++)
+    {
+        if (Snapshot->Chunks[ChunkIndex].IsValid())
+        {
+            ResidentChunks.Add(ChunkIndex);
+        }
+    }
+
+    if (ResidentChunks.Num() == 0)
+    {
+        Ar.Logf(TEXT("%s: no resident chunks to benchmark"), *GetName());
+        return;
+    }
+
+    const int32 CellsPerAxis = SnapshotLayout.ChunkSize;
+    const int32 SamplesPerAxis = CellsPerAxis + 1;
+    const double NumCells = static_cast<double>(ResidentChunks.Num()) * CellsPerAxis * CellsPerAxis * CellsPerAxis * Iterations;
+
+    // Meshing: both walks see the same samples, so they must produce the same triangles
+    int32 VoxelTriangles = 0;
+    int32 SliceTriangles = 0;
+    FVector VoxelVertexSum = FVector::ZeroVector;
+    FVector SliceVertexSum = FVector::ZeroVector;
+
+    double StartTime = FPlatformTime::Seconds();
+    for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+    {
+        for (int32 ChunkIndex : ResidentChunks)
+        {
+            TArray<FVoxel> Voxels;
+            TArray<FVector> Vertices;
+            TArray<int32> Triangles;
+            GenerateVoxelGrid(SnapshotLayout, SnapshotLayout.GetChunkCoord(ChunkIndex), Snapshot->Chunks[ChunkIndex]->Density, Voxels);
+            MarchingCubes(Voxels, Vertices, Triangles);
+
+            if (Iteration == 0)
+            {
+                VoxelTriangles += Triangles.Num() / 3;
+                for (const FVector& Vertex : Vertices)
+                {
+                    VoxelVertexSum += Vertex;
+                }
+            }
+        }
+    }
+    const double VoxelWalkSeconds = FPlatformTime::Seconds() - StartTime;
+
+    StartTime = FPlatformTime::Seconds();
+    for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+    {
+        for (int32 ChunkIndex : ResidentChunks)
+        {
+            TArray<FVector> Vertices;
+            TArray<int32> Triangles;
+            MarchingCubes(SnapshotLayout, SnapshotLayout.GetChunkCoord(ChunkIndex), Snapshot->Chunks[ChunkIndex]->Density, Vertices, Triangles);
+
+            if (Iteration == 0)
+            {
+                SliceTriangles += Triangles.Num() / 3;
+                for (const FVector& Vertex : Vertices)
+                {
+                    SliceVertexSum += Vertex;
+                }
+            }
+        }
+    }
+    const double SliceWalkSeconds = FPlatformTime::Seconds() - StartTime;
+
+    // The walks emit triangles in different orders, so the sums only agree up to rounding
+    const bool bMeshesMatch = VoxelTriangles == SliceTriangles && VoxelVertexSum.Equals(SliceVertexSum, SnapshotLayout.VoxelSize * 0.01f * FMath::Max(VoxelTriangles, 1));
+
+    Ar.Logf(TEXT("%s: meshing %d chunks x %d, per-voxel walk %.2f ns/cell, slice walk %.2f ns/cell (%.2fx), %d triangles, %s"),
+        *GetName(), ResidentChunks.Num(), Iterations,
+        VoxelWalkSeconds * 1e9 / NumCells, SliceWalkSeconds * 1e9 / NumCells, VoxelWalkSeconds / FMath::Max(SliceWalkSeconds, UE_SMALL_NUMBER),
+        SliceTriangles, bMeshesMatch ? TEXT("outputs match") : TEXT("OUTPUTS DIFFER"));
+
+    // Sampling: random points with the six gradient taps around each, as the queries and normals read them
+    TArray<TArray<float>> RowMajorDensity;
+    RowMajorDensity.SetNum(Snapshot->Chunks.Num());
+    for (int32 ChunkIndex : ResidentChunks)
+    {
+        const TArray<float>& Density = Snapshot->Chunks[ChunkIndex]->Density;
+        TArray<float>& RowMajor = RowMajorDensity[ChunkIndex];
+        RowMajor.SetNumUninitialized(Density.Num());
+
+        for (int32 z = 0; z < SamplesPerAxis; z++)
+        {
+            for (int32 y = 0; y < SamplesPerAxis; y++)
+            {
+                for (int32 x = 0; x < SamplesPerAxis; x++)
+                {
+                    RowMajor[x + (y + z * SamplesPerAxis) * SamplesPerAxis] = Density[FPlanetChunk::SampleIndex(x, y, z, CellsPerAxis)];
+                }
+            }
+        }
+    }
+
+    // Same filter as FPlanetDensitySnapshot::SampleDensity over the row-major copies
+    const auto SampleRowMajor = [&SnapshotLayout, &RowMajorDensity, SamplesPerAxis](const FVector& Position, float& OutDensity)
+    {
+        const int32 GridCells = SnapshotLayout.ChunksPerAxis * SnapshotLayout.ChunkSize;
+        const FVector GridPosition = Position / SnapshotLayout.VoxelSize + FVector(GridCells / 2.0f);
+        if (GridPosition.X < 0 || GridPosition.Y < 0 || GridPosition.Z < 0 ||
+            GridPosition.X >= GridCells || GridPosition.Y >= GridCells || GridPosition.Z >= GridCells)
+        {
+            return false;
+        }
+
+        const FIntVector Cell(FMath::FloorToInt(GridPosition.X), FMath::FloorToInt(GridPosition.Y), FMath::FloorToInt(GridPosition.Z));
+        const FVector Alpha = GridPosition - FVector(Cell);
+        const FIntVector ChunkCoord = Cell / SnapshotLayout.ChunkSize;
+        const FIntVector Local = Cell - ChunkCoord * SnapshotLayout.ChunkSize;
+        const TArray<float>& Density = RowMajorDensity[SnapshotLayout.GetChunkIndex(ChunkCoord)];
+        if (Density.Num() == 0)
+        {
+            return false;
+        }
+
+        const int32 Base = Local.X + (Local.Y + Local.Z * SamplesPerAxis) * SamplesPerAxis;
+        const int32 StrideY = SamplesPerAxis;
+        const int32 StrideZ = SamplesPerAxis * SamplesPerAxis;
+        const float* D = Density.GetData();
+
+        const float X00 = FMath::Lerp(D[Base], D[Base + 1], Alpha.X);
+        const float X10 = FMath::Lerp(D[Base + StrideY], D[Base + StrideY + 1], Alpha.X);
+        const float X01 = FMath::Lerp(D[Base + StrideZ], D[Base + StrideZ + 1], Alpha.X);
+        const float X11 = FMath::Lerp(D[Base + StrideY + StrideZ], D[Base + StrideY + StrideZ + 1], Alpha.X);
+
+        OutDensity = FMath::Lerp(FMath::Lerp(X00, X10, Alpha.Y), FMath::Lerp(X01, X11, Alpha.Y), Alpha.Z);
+        return true;
+    };
+
+    const int32 NumPoints = 65536;
+    const float H = SnapshotLayout.VoxelSize * 0.5f;
+    const FVector Taps[7] = { FVector::ZeroVector, FVector(H, 0, 0), FVector(-H, 0, 0), FVector(0, H, 0), FVector(0, -H, 0), FVector(0, 0, H), FVector(0, 0, -H) };
+
+    // Points are drawn from the resident chunks, so evicted chunks don't skew either side
+    FRandomStream Random(NoiseSeed);
+    TArray<FVector> Points;
+    Points.Reserve(NumPoints);
+    for (int32 PointIndex = 0; PointIndex < NumPoints; PointIndex++)
+    {
+        const FBox Bounds = SnapshotLayout.GetChunkBounds(SnapshotLayout.GetChunkCoord(ResidentChunks[Random.RandHelper(ResidentChunks.Num())]));
+        Points.Add(FVector(Random.FRandRange(Bounds.Min.X, Bounds.Max.X), Random.FRandRange(Bounds.Min.Y, Bounds.Max.Y), Random.FRandRange(Bounds.Min.Z, Bounds.Max.Z)));
+    }
+
+    double MortonSum = 0.0;
+    StartTime = FPlatformTime::Seconds();
+    for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+    {
+        for (const FVector& Point : Points)
+        {
+            for (const FVector& Tap : Taps)
+            {
+                float Density;
+                if (Snapshot->SampleDensity(Point + Tap, Density))
+                {
+                    MortonSum += Density;
+                }
+            }
+        }
+    }
+    const double MortonSeconds = FPlatformTime::Seconds() - StartTime;
+
+    double RowMajorSum = 0.0;
+    StartTime = FPlatformTime::Seconds();
+    for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+    {
+        for (const FVector& Point : Points)
+        {
+            for (const FVector& Tap : Taps)
+            {
+                float Density;
+                if (SampleRowMajor(Point + Tap, Density))
+                {
+                    RowMajorSum += Density;
+                }
+            }
+        }
+    }
+    const double RowMajorSeconds = FPlatformTime::Seconds() - StartTime;
+
+    const int32 NumTaps = UE_ARRAY_COUNT(Taps);
+    const double NumSamples = static_cast<double>(NumPoints) * NumTaps * Iterations;
+    Ar.Logf(TEXT("%s: sampling %d points x %d taps x %d, row-major %.2f ns/sample, Morton %.2f ns/sample (%.2fx), %s"),
+        *GetName(), NumPoints, NumTaps, Iterations,
+        RowMajorSeconds * 1e9 / NumSamples, MortonSeconds * 1e9 / NumSamples, RowMajorSeconds / FMath::Max(MortonSeconds, UE_SMALL_NUMBER),
+        FMath::IsNearlyEqual(MortonSum, RowMajorSum, FMath::Abs(RowMajorSum) * 1e-6 + 1.0) ? TEXT("outputs match") : TEXT("OUTPUTS DIFFER"));
+}
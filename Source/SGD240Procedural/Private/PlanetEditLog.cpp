@@ -0,0 +1,150 @@
+#include "PlanetEditLog.h"
+#include "PlanetActor.h"
+#include "Misc/Compression.h"
+
+// Bounds of the planet-local space touched by the brush
+FBox FPlanetBrushOp::GetBounds() const
+{
+    return FBox(Center - FVector(Radius), Center + FVector(Radius));
+}
+
+// Function to apply the brush to a single density sample
+float FPlanetBrushOp::Apply(const FVector& Position, float Density) const
+{
+    const float Distance = FVector::Dist(Position, Center);
+    if (Radius == 0 || Distance >= Radius)
+    {
+        return Density;
+    }
+
+    // Smoothstep falloff so repeated edits don't leave hard steps in the surface
+    const float Falloff = FMath::SmoothStep(0.0f, 1.0f, 1.0f - Distance / Radius);
+    const float Delta = Strength * Falloff;
+
+    return Mode == EPlanetBrushMode::Add ? Density + Delta : Density - Delta;
+}
+
+void FPlanetBrushOp::PostReplicatedAdd(const FPlanetEditLog& InArraySerializer)
+{
+    if (InArraySerializer.Owner)
+    {
+        InArraySerializer.Owner->HandleReplicatedBrushOp(*this);
+    }
+}
+
+const FPlanetBrushOp* FPlanetEditLog::FindOp(uint32 Sequence) const
+{
+    return Ops.FindByPredicate([Sequence](const FPlanetBrushOp& Op) { return Op.Sequence == Sequence; });
+}
+
+void FPlanetBakedPiece::PostReplicatedAdd(const FPlanetBakedEdits& InArraySerializer)
+{
+    if (InArraySerializer.Owner)
+    {
+        InArraySerializer.Owner->HandleReplicatedBakedPiece(*this);
+    }
+}
+
+void FPlanetBakedPiece::PostReplicatedChange(const FPlanetBakedEdits& InArraySerializer)
+{
+    PostReplicatedAdd(InArraySerializer);
+}
+
+// Function to compress a chunk delta and split it into replicated pieces
+bool FPlanetBakedEdits::SetChunkDelta(int32 ChunkIndex, uint32 Sequence, const TArray<int16>& QuantisedDelta)
+{
+    const int32 UncompressedSize = QuantisedDelta.Num() * sizeof(int16);
+    int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Zlib, UncompressedSize);
+
+    TArray<uint8> Compressed;
+    Compressed.SetNumUninitialized(CompressedSize);
+    if (!FCompression::CompressMemory(NAME_Zlib, Compressed.GetData(), CompressedSize, QuantisedDelta.GetData(), UncompressedSize))
+    {
+        return false;
+    }
+    Compressed.SetNum(CompressedSize);
+
+    // Brush sizes come from clients, so a delta that doesn't fit must fail the bake rather than assert
+    const int32 NumPieces = FMath::DivideAndRoundUp(CompressedSize, MaxPieceSize);
+    if (NumPieces > MAX_uint16)
+    {
+        return false;
+    }
+
+    Pieces.RemoveAll([ChunkIndex](const FPlanetBakedPiece& Piece) { return Piece.ChunkIndex == ChunkIndex; });
+
+    for (int32 PieceIndex = 0; PieceIndex < NumPieces; PieceIndex++)
+    {
+        const int32 Offset = PieceIndex * MaxPieceSize;
+
+        FPlanetBakedPiece& Piece = Pieces.AddDefaulted_GetRef();
+        Piece.ChunkIndex = ChunkIndex;
+        Piece.Sequence = Sequence;
+        Piece.PieceIndex = static_cast<uint16>(PieceIndex);
+        Piece.NumPieces = static_cast<uint16>(NumPieces);
+        Piece.Data.Append(Compressed.GetData() + Offset, FMath::Min(MaxPieceSize, CompressedSize - Offset));
+        MarkItemDirty(Piece);
+    }
+
+    MarkArrayDirty();
+    return true;
+}
+
+// Function to reassemble and decompress the newest delta stored for a chunk
+bool FPlanetBakedEdits::GetChunkDelta(int32 ChunkIndex, int32 NumSamples, uint32& OutSequence, TArray<int16>& OutQuantisedDelta) const
+{
+    uint32 Sequence = 0;
+    TArray<uint8> Compressed;
+    if (!GetCompressedChunkDelta(ChunkIndex, Sequence, Compressed) || !UncompressChunkDelta(Compressed, NumSamples, OutQuantisedDelta))
+    {
+        return false;
+    }
+
+    OutSequence = Sequence;
+    return true;
+}
+
+// Function to reassemble the newest delta stored for a chunk without decompressing it
+bool FPlanetBakedEdits::GetCompressedChunkDelta(int32 ChunkIndex, uint32& OutSequence, TArray<uint8>& OutCompressed) const
+{
+    // Pieces of an older bake can linger until the replacement arrives, so only use the newest set
+    uint32 Sequence = 0;
+    for (const FPlanetBakedPiece& Piece : Pieces)
+    {
+        if (Piece.ChunkIndex == ChunkIndex)
+        {
+            Sequence = FMath::Max(Sequence, Piece.Sequence);
+        }
+    }
+
+    TArray<const FPlanetBakedPiece*, TInlineAllocator<32>> Ordered;
+    for (const FPlanetBakedPiece& Piece : Pieces)
+    {
+        if (Piece.ChunkIndex == ChunkIndex && Piece.Sequence == Sequence)
+        {
+            Ordered.Add(&Piece);
+        }
+    }
+
+    if (Ordered.Num() == 0 || Ordered.Num() != Ordered[0]->NumPieces)
+    {
+        return false;
+    }
+
+    Ordered.Sort([](const FPlanetBakedPiece& A, const FPlanetBakedPiece& B) { return A.PieceIndex < B.PieceIndex; });
+
+    OutCompressed.Reset();
+    for (const FPlanetBakedPiece* Piece : Ordered)
+    {
+        OutCompressed.Append(Piece->Data);
+    }
+
+    OutSequence = Sequence;
+    return true;
+}
+
+bool FPlanetBakedEdits::UncompressChunkDelta(const TArray<uint8>& Compressed, int32 NumSamples, TArray<int16>& OutQuantisedDelta)
+{
+    OutQuantisedDelta.SetNumUninitialized(NumSamples);
+    return FCompression::UncompressMemory(NAME_Zlib, OutQuantisedDelta.GetData(), NumSamples * sizeof(int16), Compressed.GetData(), Compressed.Num());
+}
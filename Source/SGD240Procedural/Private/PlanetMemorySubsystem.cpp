@@ -0,0 +1,160 @@
+#include "PlanetMemorySubsystem.h"
+#include "PlanetActor.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_STATS_GROUP(TEXT("Planet"), STATGROUP_Planet, STATCAT_Advanced);
+DECLARE_MEMORY_STAT(TEXT("Density"), STAT_PlanetDensityMemory, STATGROUP_Planet);
+DECLARE_MEMORY_STAT(TEXT("Mesh"), STAT_PlanetMeshMemory, STATGROUP_Planet);
+DECLARE_MEMORY_STAT(TEXT("Collision (estimate)"), STAT_PlanetCollisionMemory, STATGROUP_Planet);
+DECLARE_MEMORY_STAT(TEXT("Baked Edits"), STAT_PlanetBakedEditMemory, STATGROUP_Planet);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Chunks"), STAT_PlanetChunks, STATGROUP_Planet);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Density Evicted Chunks"), STAT_PlanetDensityEvicted, STATGROUP_Planet);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Mesh Evicted Chunks"), STAT_PlanetMeshEvicted, STATGROUP_Planet);
+
+static TAutoConsoleVariable<int32> CVarPlanetMemoryBudgetMB(
+    TEXT("planet.MemoryBudgetMB"),
+    0,
+    TEXT("Memory all planets' chunk data may use before the least recently viewed chunks are evicted. 0 disables eviction."),
+    ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarPlanetEvictionDelay(
+    TEXT("planet.EvictionDelay"),
+    5.0f,
+    TEXT("Seconds a chunk must have gone unviewed before it can be evicted, so chunks at the edge of view don't thrash."),
+    ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarPlanetMaxEvictionsPerFrame(
+    TEXT("planet.MaxEvictionsPerFrame"),
+    8,
+    TEXT("Caps how many chunks are evicted in one frame. Freeing meshes and scatter updates render state, so this spreads the cost."),
+    ECVF_Default);
+
+static FAutoConsoleCommandWithWorld PlanetMemoryReportCommand(
+    TEXT("planet.MemoryReport"),
+    TEXT("Logs the memory held by each planet's chunks and how many chunks are evicted"),
+    FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+    {
+        if (const UPlanetMemorySubsystem* Memory = World ? World->GetSubsystem<UPlanetMemorySubsystem>() : nullptr)
+        {
+            Memory->DumpReport(*GLog);
+        }
+    }));
+
+FPlanetMemoryUsage& FPlanetMemoryUsage::operator+=(const FPlanetMemoryUsage& Other)
+{
+    DensityBytes += Other.DensityBytes;
+    MeshBytes += Other.MeshBytes;
+    CollisionBytes += Other.CollisionBytes;
+    BakedEditBytes += Other.BakedEditBytes;
+    NumChunks += Other.NumChunks;
+    NumDensityEvicted += Other.NumDensityEvicted;
+    NumMeshEvicted += Other.NumMeshEvicted;
+    return *this;
+}
+
+void UPlanetMemorySubsystem::RegisterPlanet(APlanetActor* Planet)
+{
+    Planets.AddUnique(Planet);
+}
+
+void UPlanetMemorySubsystem::UnregisterPlanet(APlanetActor* Planet)
+{
+    Planets.Remove(Planet);
+}
+
+FPlanetMemoryUsage UPlanetMemorySubsystem::GetTotalUsage() const
+{
+    FPlanetMemoryUsage Total;
+    for (const TWeakObjectPtr<APlanetActor>& Planet : Planets)
+    {
+        if (Planet.IsValid())
+        {
+            FPlanetMemoryUsage Usage;
+            Planet->GetMemoryUsage(Usage);
+            Total += Usage;
+        }
+    }
+    return Total;
+}
+
+void UPlanetMemorySubsystem::DumpReport(FOutputDevice& Ar) const
+{
+    const auto ToMB = [](SIZE_T Bytes) { return Bytes / (1024.0 * 1024.0); };
+
+    for (const TWeakObjectPtr<APlanetActor>& Planet : Planets)
+    {
+        if (!Planet.IsValid())
+        {
+            continue;
+        }
+
+        FPlanetMemoryUsage Usage;
+        Planet->GetMemoryUsage(Usage);
+        Ar.Logf(TEXT("%s: %.2f MB (density %.2f, mesh %.2f, collision %.2f, baked edits %.2f), %d chunks, %d density evicted, %d mesh evicted"),
+            *Planet->GetName(), ToMB(Usage.GetTotalBytes()), ToMB(Usage.DensityBytes), ToMB(Usage.MeshBytes), ToMB(Usage.CollisionBytes), ToMB(Usage.BakedEditBytes),
+            Usage.NumChunks, Usage.NumDensityEvicted, Usage.NumMeshEvicted);
+    }
+
+    const int32 BudgetMB = CVarPlanetMemoryBudgetMB.GetValueOnGameThread();
+    Ar.Logf(TEXT("Total: %.2f MB of %s"), ToMB(GetTotalUsage().GetTotalBytes()), BudgetMB > 0 ? *FString::Printf(TEXT("%d MB"), BudgetMB) : TEXT("unlimited"));
+}
+
+void UPlanetMemorySubsystem::Tick(float DeltaTime)
+{
+    Super::Tick(DeltaTime);
+
+    Planets.RemoveAll([](const TWeakObjectPtr<APlanetActor>& Planet) { return !Planet.IsValid(); });
+
+    const FPlanetMemoryUsage Usage = GetTotalUsage();
+    SET_MEMORY_STAT(STAT_PlanetDensityMemory, Usage.DensityBytes);
+    SET_MEMORY_STAT(STAT_PlanetMeshMemory, Usage.MeshBytes);
+    SET_MEMORY_STAT(STAT_PlanetCollisionMemory, Usage.CollisionBytes);
+    SET_MEMORY_STAT(STAT_PlanetBakedEditMemory, Usage.BakedEditBytes);
+    SET_DWORD_STAT(STAT_PlanetChunks, Usage.NumChunks);
+    SET_DWORD_STAT(STAT_PlanetDensityEvicted, Usage.NumDensityEvicted);
+    SET_DWORD_STAT(STAT_PlanetMeshEvicted, Usage.NumMeshEvicted);
+
+    const SIZE_T BudgetBytes = static_cast<SIZE_T>(FMath::Max(CVarPlanetMemoryBudgetMB.GetValueOnGameThread(), 0)) * 1024 * 1024;
+    SIZE_T TotalBytes = Usage.GetTotalBytes();
+    if (BudgetBytes == 0 || TotalBytes <= BudgetBytes)
+    {
+        return;
+    }
+
+    // Chunks viewed recently are never evicted, however far over budget the planets are
+    const double ViewedBefore = GetWorld()->GetTimeSeconds() - CVarPlanetEvictionDelay.GetValueOnGameThread();
+
+    TArray<FPlanetEvictionCandidate> Candidates;
+    for (const TWeakObjectPtr<APlanetActor>& Planet : Planets)
+    {
+        Planet->GetEvictionCandidates(ViewedBefore, Candidates);
+    }
+
+    // Density goes first since losing it can't be seen, then the oldest chunks across every planet
+    Candidates.Sort([](const FPlanetEvictionCandidate& A, const FPlanetEvictionCandidate& B)
+    {
+        if (A.bMesh != B.bMesh)
+        {
+            return !A.bMesh;
+        }
+        return A.LastViewedTime < B.LastViewedTime;
+    });
+
+    const int32 MaxEvictions = CVarPlanetMaxEvictionsPerFrame.GetValueOnGameThread();
+    for (int32 Index = 0; Index < Candidates.Num() && Index < MaxEvictions && TotalBytes > BudgetBytes; Index++)
+    {
+        const FPlanetEvictionCandidate& Candidate = Candidates[Index];
+        TotalBytes -= FMath::Min(Candidate.Planet->EvictChunk(Candidate.ChunkIndex, Candidate.bMesh), TotalBytes);
+    }
+}
+
+TStatId UPlanetMemorySubsystem::GetStatId() const
+{
+    RETURN_QUICK_DECLARE_CYCLE_STAT(UPlanetMemorySubsystem, STATGROUP_Tickables);
+}
+
+bool UPlanetMemorySubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+    return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
@@ -0,0 +1,504 @@
+#include "PlanetMeshComponent.h"
+#include "PrimitiveSceneProxy.h"
+#include "SceneInterface.h"
+#include "SceneManagement.h"
+#include "LocalVertexFactory.h"
+#include "StaticMeshResources.h"
+#include "RawIndexBuffer.h"
+#include "MaterialDomain.h"
+#include "Materials/Material.h"
+#include "Materials/MaterialRenderProxy.h"
+#include "PhysicsEngine/BodySetup.h"
+#include "Engine/Engine.h"
+
+// Function to octahedral encode a unit normal into two snorm16 values
+static void PackOctahedralNormal(const FVector3f& Normal, int16 OutNormal[2])
+{
+    const FVector3f N = Normal / (FMath::Abs(Normal.X) + FMath::Abs(Normal.Y) + FMath::Abs(Normal.Z));
+
+    FVector2f Oct(N.X, N.Y);
+    if (N.Z < 0)
+    {
+        // Fold the lower hemisphere over the diagonals of the square
+        Oct = FVector2f(
+            (1.0f - FMath::Abs(N.Y)) * (N.X >= 0 ? 1.0f : -1.0f),
+            (1.0f - FMath::Abs(N.X)) * (N.Y >= 0 ? 1.0f : -1.0f));
+    }
+
+    OutNormal[0] = static_cast<int16>(FMath::RoundToInt(FMath::Clamp(Oct.X, -1.0f, 1.0f) * MAX_int16));
+    OutNormal[1] = static_cast<int16>(FMath::RoundToInt(FMath::Clamp(Oct.Y, -1.0f, 1.0f) * MAX_int16));
+}
+
+void FPlanetMeshSection::AddVertex(const FVector& Position, const FVector& Normal)
+{
+    const FVector Extent = Bounds.GetSize();
+    const FVector Alpha = (Position - Bounds.Min) / Extent.ComponentMax(FVector(UE_SMALL_NUMBER));
+
+    FPlanetPackedVertex& Vertex = Vertices.AddUninitialized_GetRef();
+    for (int Axis = 0; Axis < 3; Axis++)
+    {
+        Vertex.Position[Axis] = static_cast<uint16>(FMath::RoundToInt(FMath::Clamp(Alpha[Axis], 0.0, 1.0) * MAX_uint16));
+    }
+
+    const FVector3f SafeNormal = FVector3f(Normal.GetSafeNormal(UE_SMALL_NUMBER, FVector::UpVector));
+    PackOctahedralNormal(SafeNormal, Vertex.Normal);
+}
+
+FVector3f FPlanetMeshSection::UnpackPosition(const FPlanetPackedVertex& Vertex) const
+{
+    const FVector3f Min = FVector3f(Bounds.Min);
+    const FVector3f Extent = FVector3f(Bounds.GetSize());
+
+    return Min + Extent * FVector3f(Vertex.Position[0], Vertex.Position[1], Vertex.Position[2]) / MAX_uint16;
+}
+
+FVector3f FPlanetMeshSection::UnpackNormal(const FPlanetPackedVertex& Vertex)
+{
+    const FVector2f Oct(Vertex.Normal[0] / static_cast<float>(MAX_int16), Vertex.Normal[1] / static_cast<float>(MAX_int16));
+
+    FVector3f N(Oct.X, Oct.Y, 1.0f - FMath::Abs(Oct.X) - FMath::Abs(Oct.Y));
+    const float Fold = FMath::Max(-N.Z, 0.0f);
+    N.X += N.X >= 0 ? -Fold : Fold;
+    N.Y += N.Y >= 0 ? -Fold : Fold;
+
+    return N.GetSafeNormal();
+}
+
+SIZE_T FPlanetMeshSection::GetAllocatedSize() const
+{
+    return Vertices.GetAllocatedSize() + Indices.GetAllocatedSize();
+}
+
+// GPU resources for one chunk section
+class FPlanetMeshProxySection
+{
+public:
+    FStaticMeshVertexBuffers VertexBuffers;
+    FRawStaticIndexBuffer IndexBuffer;
+    FLocalVertexFactory VertexFactory;
+    int32 NumVertices = 0;
+    int32 NumIndices = 0;
+
+    FPlanetMeshProxySection(ERHIFeatureLevel::Type InFeatureLevel)
+        : VertexFactory(InFeatureLevel, "FPlanetMeshProxySection")
+    {
+    }
+
+    ~FPlanetMeshProxySection()
+    {
+        VertexBuffers.PositionVertexBuffer.ReleaseResource();
+        VertexBuffers.StaticMeshVertexBuffer.ReleaseResource();
+        IndexBuffer.ReleaseResource();
+        VertexFactory.ReleaseResource();
+    }
+
+    // Function to unpack a compact section into GPU buffers, called on the render thread
+    void Init(FRHICommandListBase& RHICmdList, const FPlanetMeshSection& Section)
+    {
+        NumVertices = Section.Vertices.Num();
+        NumIndices = Section.Indices.Num();
+
+        // No CPU access, so the unpacked copies are freed as soon as they're uploaded
+        VertexBuffers.PositionVertexBuffer.Init(NumVertices, false);
+        VertexBuffers.StaticMeshVertexBuffer.Init(NumVertices, 1, false);
+
+        for (int32 VertexIndex = 0; VertexIndex < NumVertices; VertexIndex++)
+        {
+            const FPlanetPackedVertex& Vertex = Section.Vertices[VertexIndex];
+            const FVector3f Normal = FPlanetMeshSection::UnpackNormal(Vertex);
+
+            // Marching cubes output has no UV parameterisation, so build any tangent frame around the normal
+            const FVector3f Reference = FMath::Abs(Normal.Z) < 0.999f ? FVector3f::UpVector : FVector3f::ForwardVector;
+            const FVector3f TangentX = FVector3f::CrossProduct(Reference, Normal).GetSafeNormal();
+            const FVector3f TangentY = FVector3f::CrossProduct(Normal, TangentX);
+
+            VertexBuffers.PositionVertexBuffer.VertexPosition(VertexIndex) = Section.UnpackPosition(Vertex);
+            VertexBuffers.StaticMeshVertexBuffer.SetVertexTangents(VertexIndex, TangentX, TangentY, Normal);
+            VertexBuffers.StaticMeshVertexBuffer.SetVertexUV(VertexIndex, 0, FVector2f::ZeroVector);
+        }
+
+        // Most chunks fit in 16 bit indices, which halves the index buffer
+        IndexBuffer.SetIndices(Section.Indices, EIndexBufferStride::AutoDetect);
+
+        VertexBuffers.PositionVertexBuffer.InitResource(RHICmdList);
+        VertexBuffers.StaticMeshVertexBuffer.InitResource(RHICmdList);
+        IndexBuffer.InitResource(RHICmdList);
+
+        FLocalVertexFactory::FDataType Data;
+        VertexBuffers.PositionVertexBuffer.BindPositionVertexBuffer(&VertexFactory, Data);
+        VertexBuffers.StaticMeshVertexBuffer.BindTangentVertexBuffer(&VertexFactory, Data);
+        VertexBuffers.StaticMeshVertexBuffer.BindPackedTexCoordVertexBuffer(&VertexFactory, Data);
+        VertexBuffers.StaticMeshVertexBuffer.BindLightMapVertexBuffer(&VertexFactory, Data, 0);
+        FColorVertexBuffer::BindDefaultColorVertexBuffer(&VertexFactory, Data, FColorVertexBuffer::NullBindStride::ZeroForDefaultBufferBind);
+        VertexFactory.SetData(RHICmdList, Data);
+        VertexFactory.InitResource(RHICmdList);
+    }
+};
+
+class FPlanetMeshSceneProxy final : public FPrimitiveSceneProxy
+{
+public:
+    FPlanetMeshSceneProxy(UPlanetMeshComponent* Component)
+        : FPrimitiveSceneProxy(Component)
+        , MaterialRelevance(Component->GetMaterialRelevance(GetScene().GetFeatureLevel()))
+    {
+        Material = Component->GetMaterial(0);
+        if (Material == nullptr)
+        {
+            Material = UMaterial::GetDefaultMaterial(MD_Surface);
+        }
+
+        Sections.SetNum(Component->GetNumChunkSections());
+
+        // Hand every existing section to the render thread in one command
+        TArray<FPlanetMeshSection> InitialSections;
+        for (int32 SectionIndex = 0; SectionIndex < Component->GetNumChunkSections(); SectionIndex++)
+        {
+            InitialSections.Add(*Component->GetChunkSection(SectionIndex));
+        }
+
+        ENQUEUE_RENDER_COMMAND(FPlanetMeshSceneProxyInit)(
+            [this, InitialSections = MoveTemp(InitialSections)](FRHICommandListImmediate& RHICmdList)
+            {
+                for (int32 SectionIndex = 0; SectionIndex < InitialSections.Num(); SectionIndex++)
+                {
+                    SetSection_RenderThread(RHICmdList, SectionIndex, InitialSections[SectionIndex]);
+                }
+            });
+    }
+
+    virtual ~FPlanetMeshSceneProxy()
+    {
+        for (FPlanetMeshProxySection* Section : Sections)
+        {
+            delete Section;
+        }
+    }
+
+    // Function to replace a single section's buffers, leaving every other section untouched
+    void SetSection_RenderThread(FRHICommandListBase& RHICmdList, int32 SectionIndex, const FPlanetMeshSection& Section)
+    {
+        check(IsInRenderingThread());
+
+        if (SectionIndex >= Sections.Num())
+        {
+            Sections.SetNumZeroed(SectionIndex + 1);
+        }
+
+        delete Sections[SectionIndex];
+        Sections[SectionIndex] = nullptr;
+
+        if (Section.Indices.Num() > 0)
+        {
+            Sections[SectionIndex] = new FPlanetMeshProxySection(GetScene().GetFeatureLevel());
+            Sections[SectionIndex]->Init(RHICmdList, Section);
+        }
+    }
+
+    virtual void GetDynamicMeshElements(const TArray<const FSceneView*>& Views, const FSceneViewFamily& ViewFamily, uint32 VisibilityMap, FMeshElementCollector& Collector) const override
+    {
+        const bool bWireframe = AllowDebugViewmodes() && ViewFamily.EngineShowFlags.Wireframe;
+
+        FMaterialRenderProxy* MaterialProxy = Material->GetRenderProxy();
+        if (bWireframe)
+        {
+            FColoredMaterialRenderProxy* WireframeMaterialInstance = new FColoredMaterialRenderProxy(
+                GEngine->WireframeMaterial ? GEngine->WireframeMaterial->GetRenderProxy() : nullptr,
+                FLinearColor(0, 0.5f, 1.f));
+            Collector.RegisterOneFrameMaterialProxy(WireframeMaterialInstance);
+            MaterialProxy = WireframeMaterialInstance;
+        }
+
+        if (VisibilityMap == 0)
+        {
+            return;
+        }
+
+        // The primitive parameters are the same for every section and view, so one buffer serves every batch
+        bool bHasPrecomputedVolumetricLightmap;
+        FMatrix PreviousLocalToWorld;
+        int32 SingleCaptureIndex;
+        bool bOutputVelocity;
+        GetScene().GetPrimitiveUniformShaderParameters_RenderThread(GetPrimitiveSceneInfo(), bHasPrecomputedVolumetricLightmap, PreviousLocalToWorld, SingleCaptureIndex, bOutputVelocity);
+        bOutputVelocity |= AlwaysHasVelocity();
+
+        FDynamicPrimitiveUniformBuffer& DynamicPrimitiveUniformBuffer = Collector.AllocateOneFrameResource<FDynamicPrimitiveUniformBuffer>();
+        DynamicPrimitiveUniformBuffer.Set(Collector.GetRHICommandList(), GetLocalToWorld(), PreviousLocalToWorld, GetBounds(), GetLocalBounds(), GetLocalBounds(), true, bHasPrecomputedVolumetricLightmap, bOutputVelocity, GetCustomPrimitiveData());
+
+        for (int32 ViewIndex = 0; ViewIndex < Views.Num(); ViewIndex++)
+        {
+            if (!(VisibilityMap & (1 << ViewIndex)))
+            {
+                continue;
+            }
+
+            for (const FPlanetMeshProxySection* Section : Sections)
+            {
+                if (Section == nullptr)
+                {
+                    continue;
+                }
+
+                FMeshBatch& Mesh = Collector.AllocateMesh();
+                FMeshBatchElement& BatchElement = Mesh.Elements[0];
+                BatchElement.IndexBuffer = &Section->IndexBuffer;
+                Mesh.bWireframe = bWireframe;
+                Mesh.VertexFactory = &Section->VertexFactory;
+                Mesh.MaterialRenderProxy = MaterialProxy;
+                BatchElement.PrimitiveUniformBufferResource = &DynamicPrimitiveUniformBuffer.UniformBuffer;
+
+                BatchElement.FirstIndex = 0;
+                BatchElement.NumPrimitives = Section->NumIndices / 3;
+                BatchElement.MinVertexIndex = 0;
+                BatchElement.MaxVertexIndex = Section->NumVertices - 1;
+                Mesh.ReverseCulling = IsLocalToWorldDeterminantNegative();
+                Mesh.Type = PT_TriangleList;
+                Mesh.DepthPriorityGroup = SDPG_World;
+                Mesh.bCanApplyViewModeOverrides = false;
+                Collector.AddMesh(ViewIndex, Mesh);
+            }
+        }
+    }
+
+    virtual FPrimitiveViewRelevance GetViewRelevance(const FSceneView* View) const override
+    {
+        FPrimitiveViewRelevance Result;
+        Result.bDrawRelevance = IsShown(View);
+        Result.bShadowRelevance = IsShadowCast(View);
+        Result.bDynamicRelevance = true;
+        Result.bRenderInMainPass = ShouldRenderInMainPass();
+        Result.bUsesLightingChannels = GetLightingChannelMask() != GetDefaultLightingChannelMask();
+        Result.bRenderCustomDepth = ShouldRenderCustomDepth();
+        Result.bTranslucentSelfShadow = bCastVolumetricTranslucentShadow;
+        MaterialRelevance.SetPrimitiveViewRelevance(Result);
+        Result.bVelocityRelevance = DrawsVelocity() && Result.bOpaque && Result.bRenderInMainPass;
+        return Result;
+    }
+
+    virtual bool CanBeOccluded() const override
+    {
+        return !MaterialRelevance.bDisableDepthTest;
+    }
+
+    virtual SIZE_T GetTypeHash() const override
+    {
+        static size_t UniquePointer;
+        return reinterpret_cast<size_t>(&UniquePointer);
+    }
+
+    virtual uint32 GetMemoryFootprint() const override
+    {
+        return sizeof(*this) + GetAllocatedSize();
+    }
+
+    uint32 GetAllocatedSize() const
+    {
+        return FPrimitiveSceneProxy::GetAllocatedSize() + Sections.GetAllocatedSize();
+    }
+
+private:
+    TArray<FPlanetMeshProxySection*> Sections;
+    UMaterialInterface* Material;
+    FMaterialRelevance MaterialRelevance;
+};
+
+UPlanetMeshComponent::UPlanetMeshComponent(const FObjectInitializer& ObjectInitializer)
+    : Super(ObjectInitializer)
+{
+    bUseAsyncCooking = true;
+    LocalBounds = FBox(ForceInit);
+    BodySetup = nullptr;
+}
+
+void UPlanetMeshComponent::SetChunkSection(int32 SectionIndex, FPlanetMeshSection&& Section)
+{
+    if (SectionIndex >= Sections.Num())
+    {
+        Sections.SetNum(SectionIndex + 1);
+    }
+
+    Sections[SectionIndex] = MoveTemp(Section);
+    SendSectionToProxy(SectionIndex);
+}
+
+void UPlanetMeshComponent::ClearChunkSection(int32 SectionIndex)
+{
+    if (Sections.IsValidIndex(SectionIndex))
+    {
+        Sections[SectionIndex] = FPlanetMeshSection();
+        SendSectionToProxy(SectionIndex);
+    }
+}
+
+const FPlanetMeshSection* UPlanetMeshComponent::GetChunkSection(int32 SectionIndex) const
+{
+    return Sections.IsValidIndex(SectionIndex) ? &Sections[SectionIndex] : nullptr;
+}
+
+// Function to push one section to the existing scene proxy instead of rebuilding the whole proxy
+void UPlanetMeshComponent::SendSectionToProxy(int32 SectionIndex)
+{
+    UpdateLocalBounds();
+
+    FPlanetMeshSceneProxy* PlanetSceneProxy = static_cast<FPlanetMeshSceneProxy*>(SceneProxy);
+    if (PlanetSceneProxy == nullptr)
+    {
+        MarkRenderStateDirty();
+        return;
+    }
+
+    // The render thread gets its own copy of the compact data and unpacks it there
+    FPlanetMeshSection SectionCopy = Sections[SectionIndex];
+    ENQUEUE_RENDER_COMMAND(FPlanetMeshSectionUpdate)(
+        [PlanetSceneProxy, SectionIndex, SectionCopy = MoveTemp(SectionCopy)](FRHICommandListImmediate& RHICmdList)
+        {
+            PlanetSceneProxy->SetSection_RenderThread(RHICmdList, SectionIndex, SectionCopy);
+        });
+
+    // Only the bounds changed as far as the scene is concerned
+    MarkRenderTransformDirty();
+}
+
+void UPlanetMeshComponent::UpdateLocalBounds()
+{
+    LocalBounds = FBox(ForceInit);
+    for (const FPlanetMeshSection& Section : Sections)
+    {
+        if (Section.Indices.Num() > 0)
+        {
+            LocalBounds += Section.Bounds;
+        }
+    }
+
+    UpdateBounds();
+}
+
+FBoxSphereBounds UPlanetMeshComponent::CalcBounds(const FTransform& LocalToWorld) const
+{
+    const FBoxSphereBounds Bounds = LocalBounds.IsValid ? FBoxSphereBounds(LocalBounds) : FBoxSphereBounds(FVector::ZeroVector, FVector::ZeroVector, 0);
+    return Bounds.TransformBy(LocalToWorld);
+}
+
+FPrimitiveSceneProxy* UPlanetMeshComponent::CreateSceneProxy()
+{
+    return new FPlanetMeshSceneProxy(this);
+}
+
+int32 UPlanetMeshComponent::GetNumMaterials() const
+{
+    // Every chunk shares the planet material
+    return 1;
+}
+
+bool UPlanetMeshComponent::GetPhysicsTriMeshData(FTriMeshCollisionData* CollisionData, bool InUseAllTriData)
+{
+    for (const FPlanetMeshSection& Section : Sections)
+    {
+        const int32 VertexBase = CollisionData->Vertices.Num();
+
+        for (const FPlanetPackedVertex& Vertex : Section.Vertices)
+        {
+            CollisionData->Vertices.Add(Section.UnpackPosition(Vertex));
+        }
+
+        for (int32 Index = 0; Index + 2 < Section.Indices.Num(); Index += 3)
+        {
+            FTriIndices& Triangle = CollisionData->Indices.AddDefaulted_GetRef();
+            Triangle.v0 = Section.Indices[Index] + VertexBase;
+            Triangle.v1 = Section.Indices[Index + 1] + VertexBase;
+            Triangle.v2 = Section.Indices[Index + 2] + VertexBase;
+
+            CollisionData->MaterialIndices.Add(0);
+        }
+    }
+
+    CollisionData->bFlipNormals = true;
+    CollisionData->bDeformableMesh = true;
+    CollisionData->bFastCook = true;
+
+    return CollisionData->Indices.Num() > 0;
+}
+
+bool UPlanetMeshComponent::ContainsPhysicsTriMeshData(bool InUseAllTriData) const
+{
+    for (const FPlanetMeshSection& Section : Sections)
+    {
+        if (Section.Indices.Num() >= 3)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+UBodySetup* UPlanetMeshComponent::CreateBodySetupHelper()
+{
+    UBodySetup* NewBodySetup = NewObject<UBodySetup>(this, NAME_None, IsTemplate() ? RF_Public | RF_ArchetypeObject : RF_NoFlags);
+    NewBodySetup->BodySetupGuid = FGuid::NewGuid();
+    NewBodySetup->bGenerateMirroredCollision = false;
+    NewBodySetup->bDoubleSidedGeometry = true;
+    NewBodySetup->CollisionTraceFlag = CTF_UseComplexAsSimple;
+    return NewBodySetup;
+}
+
+UBodySetup* UPlanetMeshComponent::GetBodySetup()
+{
+    if (BodySetup == nullptr)
+    {
+        BodySetup = CreateBodySetupHelper();
+    }
+    return BodySetup;
+}
+
+void UPlanetMeshComponent::UpdateCollision()
+{
+    UWorld* World = GetWorld();
+    const bool bUseAsyncCook = World && World->IsGameWorld() && bUseAsyncCooking;
+
+    if (bUseAsyncCook)
+    {
+        AsyncBodySetupQueue.Add(CreateBodySetupHelper());
+    }
+    else
+    {
+        // Cooking synchronously, so anything still queued is stale
+        AsyncBodySetupQueue.Empty();
+        GetBodySetup();
+    }
+
+    UBodySetup* UseBodySetup = bUseAsyncCook ? AsyncBodySetupQueue.Last() : BodySetup;
+    UseBodySetup->BodySetupGuid = FGuid::NewGuid();
+    UseBodySetup->bHasCookedCollisionData = true;
+    UseBodySetup->InvalidatePhysicsData();
+
+    if (bUseAsyncCook)
+    {
+        UseBodySetup->CreatePhysicsMeshesAsync(FOnAsyncPhysicsCookFinished::CreateUObject(this, &UPlanetMeshComponent::FinishPhysicsAsyncCook, UseBodySetup));
+    }
+    else
+    {
+        UseBodySetup->CreatePhysicsMeshes();
+        RecreatePhysicsState();
+    }
+}
+
+void UPlanetMeshComponent::FinishPhysicsAsyncCook(bool bSuccess, UBodySetup* FinishedBodySetup)
+{
+    const int32 FoundIndex = AsyncBodySetupQueue.Find(FinishedBodySetup);
+    if (FoundIndex == INDEX_NONE)
+    {
+        return;
+    }
+
+    if (bSuccess)
+    {
+        // This cook and anything queued before it is now superseded
+        BodySetup = FinishedBodySetup;
+        RecreatePhysicsState();
+        AsyncBodySetupQueue.RemoveAt(0, FoundIndex + 1);
+    }
+    else
+    {
+        AsyncBodySetupQueue.RemoveAt(FoundIndex);
+    }
+}
@@ -0,0 +1,264 @@
+#include "PlanetNoiseVolume.h"
+#include "Async/ParallelFor.h"
+#include "Async/Future.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/ScopeLock.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogPlanetNoise, Log, All);
+
+static TAutoConsoleVariable<int32> CVarPlanetMaxNoiseVolumeMB(
+    TEXT("planet.MaxNoiseVolumeMB"),
+    256,
+    TEXT("Largest noise volume a planet may bake. Bigger volumes are refused and the planet evaluates the noise analytically."),
+    ECVF_Default);
+
+// Tricubic filtering reads one sample below and two above the cell, so pad the box by that much
+static constexpr int32 NoiseVolumePadding = 2;
+
+namespace
+{
+    struct FNoiseVolumeKey
+    {
+        FIntVector MinSample;
+        FIntVector Dimensions;
+        int32 SamplesPerUnit;
+
+        bool operator==(const FNoiseVolumeKey& Other) const
+        {
+            return MinSample == Other.MinSample && Dimensions == Other.Dimensions && SamplesPerUnit == Other.SamplesPerUnit;
+        }
+
+        friend uint32 GetTypeHash(const FNoiseVolumeKey& Key)
+        {
+            return HashCombine(HashCombine(GetTypeHash(Key.MinSample), GetTypeHash(Key.Dimensions)), GetTypeHash(Key.SamplesPerUnit));
+        }
+    };
+
+    using FNoiseVolumePtr = TSharedPtr<const FPlanetNoiseVolume, ESPMode::ThreadSafe>;
+
+    // A baked volume, held weakly so it's freed once no planet uses it, or the result of a bake still running
+    struct FNoiseVolumeCacheEntry
+    {
+        TWeakPtr<const FPlanetNoiseVolume, ESPMode::ThreadSafe> Volume;
+        TSharedFuture<FNoiseVolumePtr> PendingBake;
+    };
+
+    // Only held to look up or update entries, never while baking
+    FCriticalSection NoiseVolumeCacheLock;
+    TMap<FNoiseVolumeKey, FNoiseVolumeCacheEntry> NoiseVolumeCache;
+
+    // Catmull-Rom spline through four evenly spaced values, evaluated between B and C
+    FORCEINLINE float CubicInterpolate(float A, float B, float C, float D, float Alpha)
+    {
+        return B + 0.5f * Alpha * (C - A + Alpha * (2.0f * A - 5.0f * B + 4.0f * C - D + Alpha * (3.0f * (B - C) + D - A)));
+    }
+}
+
+TSharedPtr<const FPlanetNoiseVolume, ESPMode::ThreadSafe> FPlanetNoiseVolume::FindOrBake(const FVector& NoiseMin, const FVector& NoiseMax, int32 InSamplesPerUnit)
+{
+    // Snap the box to the sample grid so planets with the same seed and scale share a key
+    FNoiseVolumeKey Key;
+    Key.SamplesPerUnit = FMath::Max(InSamplesPerUnit, 1);
+    Key.MinSample = FIntVector(
+        FMath::FloorToInt(NoiseMin.X * Key.SamplesPerUnit),
+        FMath::FloorToInt(NoiseMin.Y * Key.SamplesPerUnit),
+        FMath::FloorToInt(NoiseMin.Z * Key.SamplesPerUnit)) - FIntVector(NoiseVolumePadding);
+    const FIntVector MaxSample = FIntVector(
+        FMath::CeilToInt(NoiseMax.X * Key.SamplesPerUnit),
+        FMath::CeilToInt(NoiseMax.Y * Key.SamplesPerUnit),
+        FMath::CeilToInt(NoiseMax.Z * Key.SamplesPerUnit)) + FIntVector(NoiseVolumePadding);
+    Key.Dimensions = MaxSample - Key.MinSample + FIntVector(1);
+
+    const int64 VolumeBytes = static_cast<int64>(Key.Dimensions.X) * Key.Dimensions.Y * Key.Dimensions.Z * sizeof(int16);
+    const int64 MaxVolumeBytes = static_cast<int64>(FMath::Max(CVarPlanetMaxNoiseVolumeMB.GetValueOnAnyThread(), 0)) * 1024 * 1024;
+    if (VolumeBytes > MaxVolumeBytes)
+    {
+        UE_LOG(LogPlanetNoise, Warning, TEXT("Not baking a %dx%dx%d noise volume at %d samples per unit: %.1f MB is over planet.MaxNoiseVolumeMB (%d). Lower NoiseVolumeResolution."),
+            Key.Dimensions.X, Key.Dimensions.Y, Key.Dimensions.Z, Key.SamplesPerUnit, VolumeBytes / (1024.0 * 1024.0), CVarPlanetMaxNoiseVolumeMB.GetValueOnAnyThread());
+        return nullptr;
+    }
+
+    // Park a pending entry while baking, so planets wanting the same volume wait for this bake
+    // and planets wanting other volumes aren't held up at all
+    TPromise<FNoiseVolumePtr> BakePromise;
+    {
+        FScopeLock Lock(&NoiseVolumeCacheLock);
+
+        FNoiseVolumeCacheEntry& Entry = NoiseVolumeCache.FindOrAdd(Key);
+        if (FNoiseVolumePtr Volume = Entry.Volume.Pin())
+        {
+            return Volume;
+        }
+
+        if (Entry.PendingBake.IsValid())
+        {
+            const TSharedFuture<FNoiseVolumePtr> PendingBake = Entry.PendingBake;
+            Lock.Unlock();
+            return PendingBake.Get();
+        }
+
+        Entry.PendingBake = BakePromise.GetFuture().Share();
+    }
+
+    TSharedPtr<FPlanetNoiseVolume, ESPMode::ThreadSafe> Volume = MakeShared<FPlanetNoiseVolume, ESPMode::ThreadSafe>();
+    Volume->MinSample = Key.MinSample;
+    Volume->Dimensions = Key.Dimensions;
+    Volume->SamplesPerUnit = Key.SamplesPerUnit;
+    Volume->Bake();
+    Volume->Measure();
+
+    const FPlanetNoiseVolumeReport& Report = Volume->GetReport();
+    UE_LOG(LogPlanetNoise, Log, TEXT("Baked %dx%dx%d noise volume at %d samples per unit (%.1f MB). Trilinear error max %.4f rms %.4f at %.1f ns, tricubic error max %.4f rms %.4f at %.1f ns, PerlinNoise3D %.1f ns"),
+        Key.Dimensions.X, Key.Dimensions.Y, Key.Dimensions.Z, Key.SamplesPerUnit, Volume->GetAllocatedSize() / (1024.0f * 1024.0f),
+        Report.TrilinearMax, Report.TrilinearRms, Report.TrilinearNs, Report.TricubicMax, Report.TricubicRms, Report.TricubicNs, Report.AnalyticNs);
+
+    {
+        FScopeLock Lock(&NoiseVolumeCacheLock);
+
+        FNoiseVolumeCacheEntry& Entry = NoiseVolumeCache.FindOrAdd(Key);
+        Entry.Volume = Volume;
+        Entry.PendingBake = TSharedFuture<FNoiseVolumePtr>();
+    }
+
+    BakePromise.SetValue(Volume);
+    return Volume;
+}
+
+// Function to evaluate the analytic noise at every sample of the volume
+void FPlanetNoiseVolume::Bake()
+{
+    Samples.SetNumUninitialized(Dimensions.X * Dimensions.Y * Dimensions.Z);
+
+    ParallelFor(Dimensions.Z, [this](int32 z)
+    {
+        for (int32 y = 0; y < Dimensions.Y; y++)
+        {
+            for (int32 x = 0; x < Dimensions.X; x++)
+            {
+                const FVector NoisePosition = FVector(MinSample + FIntVector(x, y, z)) / SamplesPerUnit;
+                const float Noise = FMath::Clamp(FMath::PerlinNoise3D(NoisePosition), -1.0f, 1.0f);
+                Samples[x + (y + z * Dimensions.Y) * Dimensions.X] = static_cast<int16>(FMath::RoundToInt(Noise * MAX_int16));
+            }
+        }
+    });
+}
+
+// Function to compare both filters against the analytic noise at random points inside the volume,
+// for accuracy and for speed
+void FPlanetNoiseVolume::Measure()
+{
+    const int32 NumTestPoints = 4096;
+    constexpr int32 NumTimingRounds = 16;
+
+    // Fixed seed so the report is the same every time the same volume is baked
+    FRandomStream Stream(0x504C4E54);
+    const FVector Min = FVector(MinSample + FIntVector(NoiseVolumePadding)) / SamplesPerUnit;
+    const FVector Max = FVector(MinSample + Dimensions - FIntVector(NoiseVolumePadding + 1)) / SamplesPerUnit;
+
+    TArray<FVector> TestPoints;
+    TestPoints.Reserve(NumTestPoints);
+    for (int32 PointIndex = 0; PointIndex < NumTestPoints; PointIndex++)
+    {
+        TestPoints.Add(FVector(Stream.FRandRange(Min.X, Max.X), Stream.FRandRange(Min.Y, Max.Y), Stream.FRandRange(Min.Z, Max.Z)));
+    }
+
+    double TrilinearSquared = 0.0;
+    double TricubicSquared = 0.0;
+
+    for (const FVector& NoisePosition : TestPoints)
+    {
+        const float Analytic = FMath::PerlinNoise3D(NoisePosition);
+
+        float Trilinear = Analytic;
+        float Tricubic = Analytic;
+        Sample(NoisePosition, EPlanetNoiseFilter::Trilinear, Trilinear);
+        Sample(NoisePosition, EPlanetNoiseFilter::Tricubic, Tricubic);
+
+        Report.TrilinearMax = FMath::Max(Report.TrilinearMax, FMath::Abs(Trilinear - Analytic));
+        Report.TricubicMax = FMath::Max(Report.TricubicMax, FMath::Abs(Tricubic - Analytic));
+        TrilinearSquared += FMath::Square(Trilinear - Analytic);
+        TricubicSquared += FMath::Square(Tricubic - Analytic);
+    }
+
+    Report.TrilinearRms = FMath::Sqrt(TrilinearSquared / NumTestPoints);
+    Report.TricubicRms = FMath::Sqrt(TricubicSquared / NumTestPoints);
+
+    // Time each way of getting the noise over the same points. The sums keep the calls from being optimised away.
+    const auto TimeNs = [&TestPoints](const auto& Evaluate, float& OutSum)
+    {
+        float Sum = 0.0f;
+        const double StartTime = FPlatformTime::Seconds();
+        for (int32 Round = 0; Round < NumTimingRounds; Round++)
+        {
+            for (const FVector& NoisePosition : TestPoints)
+            {
+                Sum += Evaluate(NoisePosition);
+            }
+        }
+        OutSum = Sum;
+        return static_cast<float>((FPlatformTime::Seconds() - StartTime) * 1e9 / (static_cast<double>(TestPoints.Num()) * NumTimingRounds));
+    };
+
+    float AnalyticSum, TrilinearSum, TricubicSum;
+    Report.AnalyticNs = TimeNs([](const FVector& NoisePosition)
+    {
+        return FMath::PerlinNoise3D(NoisePosition);
+    }, AnalyticSum);
+    Report.TrilinearNs = TimeNs([this](const FVector& NoisePosition)
+    {
+        float Noise = 0.0f;
+        Sample(NoisePosition, EPlanetNoiseFilter::Trilinear, Noise);
+        return Noise;
+    }, TrilinearSum);
+    Report.TricubicNs = TimeNs([this](const FVector& NoisePosition)
+    {
+        float Noise = 0.0f;
+        Sample(NoisePosition, EPlanetNoiseFilter::Tricubic, Noise);
+        return Noise;
+    }, TricubicSum);
+
+    UE_LOG(LogPlanetNoise, Verbose, TEXT("Noise timing checksums %f %f %f"), AnalyticSum, TrilinearSum, TricubicSum);
+}
+
+bool FPlanetNoiseVolume::Sample(const FVector& NoisePosition, EPlanetNoiseFilter Filter, float& OutNoise) const
+{
+    const FVector SamplePosition = NoisePosition * SamplesPerUnit - FVector(MinSample);
+    const FIntVector Cell(FMath::FloorToInt(SamplePosition.X), FMath::FloorToInt(SamplePosition.Y), FMath::FloorToInt(SamplePosition.Z));
+
+    // Both filters only ever read inside the padding, so one bounds check covers them
+    if (Cell.X < 1 || Cell.Y < 1 || Cell.Z < 1 ||
+        Cell.X + 2 >= Dimensions.X || Cell.Y + 2 >= Dimensions.Y || Cell.Z + 2 >= Dimensions.Z)
+    {
+        return false;
+    }
+
+    const FVector Alpha = SamplePosition - FVector(Cell);
+
+    if (Filter == EPlanetNoiseFilter::Trilinear)
+    {
+        const float X00 = FMath::Lerp(Load(Cell.X, Cell.Y, Cell.Z), Load(Cell.X + 1, Cell.Y, Cell.Z), Alpha.X);
+        const float X10 = FMath::Lerp(Load(Cell.X, Cell.Y + 1, Cell.Z), Load(Cell.X + 1, Cell.Y + 1, Cell.Z), Alpha.X);
+        const float X01 = FMath::Lerp(Load(Cell.X, Cell.Y, Cell.Z + 1), Load(Cell.X + 1, Cell.Y, Cell.Z + 1), Alpha.X);
+        const float X11 = FMath::Lerp(Load(Cell.X, Cell.Y + 1, Cell.Z + 1), Load(Cell.X + 1, Cell.Y + 1, Cell.Z + 1), Alpha.X);
+
+        OutNoise = FMath::Lerp(FMath::Lerp(X00, X10, Alpha.Y), FMath::Lerp(X01, X11, Alpha.Y), Alpha.Z);
+        return true;
+    }
+
+    // Separable Catmull-Rom over the surrounding 4x4x4 block
+    float Planes[4];
+    for (int32 dz = 0; dz < 4; dz++)
+    {
+        float Rows[4];
+        for (int32 dy = 0; dy < 4; dy++)
+        {
+            const int32 Y = Cell.Y + dy - 1;
+            const int32 Z = Cell.Z + dz - 1;
+            Rows[dy] = CubicInterpolate(Load(Cell.X - 1, Y, Z), Load(Cell.X, Y, Z), Load(Cell.X + 1, Y, Z), Load(Cell.X + 2, Y, Z), Alpha.X);
+        }
+        Planes[dz] = CubicInterpolate(Rows[0], Rows[1], Rows[2], Rows[3], Alpha.Y);
+    }
+
+    OutNoise = CubicInterpolate(Planes[0], Planes[1], Planes[2], Planes[3], Alpha.Z);
+    return true;
+}
@@ -0,0 +1,194 @@
+#include "PlanetScatter.h"
+#include "PlanetMeshComponent.h"
+
+namespace
+{
+    // Candidates per spacing-sized square of surface. More packs instances closer to the spacing limit.
+    constexpr float ScatterOversample = 4.0f;
+
+    struct FScatterCandidate
+    {
+        FVector3f Position;
+        FVector3f Normal;
+        uint32 Hash;
+    };
+
+    // Murmur3 finaliser, spreads every input bit across the whole hash
+    FORCEINLINE uint32 MixHash(uint32 Hash)
+    {
+        Hash ^= Hash >> 16;
+        Hash *= 0x85EBCA6B;
+        Hash ^= Hash >> 13;
+        Hash *= 0xC2B2AE35;
+        Hash ^= Hash >> 16;
+        return Hash;
+    }
+
+    // Uniform float in [0, 1) from the top 24 bits of a hash
+    FORCEINLINE float HashToUnit(uint32 Hash)
+    {
+        return (Hash >> 8) * (1.0f / 16777216.0f);
+    }
+}
+
+// Function to place every rule's instances on one chunk. Spacing is only enforced within the chunk,
+// so instances either side of a chunk border can sit slightly closer than Spacing.
+void FPlanetScatter::ScatterSection(const FPlanetMeshSection& Section, TArrayView<const FPlanetScatterRule> Rules, float PlanetRadius, int32 Seed, FPlanetChunkScatter& OutScatter)
+{
+    OutScatter.RuleInstances.SetNum(Rules.Num());
+
+    // Packed positions are relative to the chunk, so mix the chunk in to decorrelate neighbours
+    const FIntVector BoundsKey(FMath::RoundToInt(Section.Bounds.Min.X), FMath::RoundToInt(Section.Bounds.Min.Y), FMath::RoundToInt(Section.Bounds.Min.Z));
+    const uint32 SectionHash = MixHash(HashCombine(GetTypeHash(BoundsKey), static_cast<uint32>(Seed)));
+
+    for (int32 RuleIndex = 0; RuleIndex < Rules.Num(); RuleIndex++)
+    {
+        const FPlanetScatterRule& Rule = Rules[RuleIndex];
+        TArray<FTransform>& Instances = OutScatter.RuleInstances[RuleIndex];
+        Instances.Reset();
+
+        if (!Rule.Mesh || Section.Indices.Num() == 0)
+        {
+            continue;
+        }
+
+        // Blueprints can set Spacing below its editor ClampMin, and zero would make the candidate count infinite
+        const float Spacing = FMath::Max(Rule.Spacing, 10.0f);
+
+        const uint32 RuleHash = MixHash(SectionHash ^ MixHash(RuleIndex + 1));
+        const float CandidatesPerArea = ScatterOversample / FMath::Square(Spacing);
+        const float MinSlopeCos = FMath::Cos(FMath::DegreesToRadians(Rule.MaxSlope));
+        const float MaxSlopeCos = FMath::Cos(FMath::DegreesToRadians(Rule.MinSlope));
+
+        TArray<FScatterCandidate> Candidates;
+
+        for (int32 Index = 0; Index + 2 < Section.Indices.Num(); Index += 3)
+        {
+            const FPlanetPackedVertex* Corners[3] = {
+                &Section.Vertices[Section.Indices[Index]],
+                &Section.Vertices[Section.Indices[Index + 1]],
+                &Section.Vertices[Section.Indices[Index + 2]]
+            };
+
+            FVector3f Positions[3];
+            FVector3f Normals[3];
+
+            // Hash the packed positions, so an untouched triangle gets the same candidates after a re-mesh
+            uint32 TriangleHash = RuleHash;
+            for (int32 Corner = 0; Corner < 3; Corner++)
+            {
+                Positions[Corner] = Section.UnpackPosition(*Corners[Corner]);
+                Normals[Corner] = FPlanetMeshSection::UnpackNormal(*Corners[Corner]);
+
+                for (int32 Axis = 0; Axis < 3; Axis++)
+                {
+                    TriangleHash = HashCombine(TriangleHash, Corners[Corner]->Position[Axis]);
+                }
+            }
+            TriangleHash = MixHash(TriangleHash);
+
+            const float Area = 0.5f * FVector3f::CrossProduct(Positions[1] - Positions[0], Positions[2] - Positions[0]).Size();
+
+            // Stochastic rounding keeps the expected count right on triangles smaller than one candidate
+            const float ExpectedCandidates = Area * CandidatesPerArea;
+            int32 NumCandidates = FMath::FloorToInt(ExpectedCandidates);
+            if (HashToUnit(TriangleHash) < ExpectedCandidates - NumCandidates)
+            {
+                NumCandidates++;
+            }
+
+            for (int32 CandidateIndex = 0; CandidateIndex < NumCandidates; CandidateIndex++)
+            {
+                const uint32 Hash = MixHash(TriangleHash + (CandidateIndex + 1) * 0x9E3779B9u);
+
+                // Uniformly distributed barycentric coordinates
+                const float R1 = FMath::Sqrt(HashToUnit(MixHash(Hash ^ 0x1)));
+                const float R2 = HashToUnit(MixHash(Hash ^ 0x2));
+                const float W0 = 1.0f - R1;
+                const float W1 = R1 * (1.0f - R2);
+                const float W2 = R1 * R2;
+
+                FScatterCandidate Candidate;
+                Candidate.Position = Positions[0] * W0 + Positions[1] * W1 + Positions[2] * W2;
+                Candidate.Normal = (Normals[0] * W0 + Normals[1] * W1 + Normals[2] * W2).GetSafeNormal();
+                Candidate.Hash = Hash;
+
+                // Slope and altitude are both measured along the radial up direction
+                const float Distance = Candidate.Position.Size();
+                if (Distance < UE_SMALL_NUMBER || Candidate.Normal.IsZero())
+                {
+                    continue;
+                }
+
+                const float Altitude = Distance - PlanetRadius;
+                const float SlopeCos = FVector3f::DotProduct(Candidate.Normal, Candidate.Position / Distance);
+
+                if (Altitude < Rule.MinAltitude || Altitude > Rule.MaxAltitude || SlopeCos < MinSlopeCos || SlopeCos > MaxSlopeCos)
+                {
+                    continue;
+                }
+
+                Candidates.Add(Candidate);
+            }
+        }
+
+        // Visit candidates in hashed priority order, keeping each one with no kept neighbour within Spacing
+        Candidates.Sort([](const FScatterCandidate& A, const FScatterCandidate& B)
+        {
+            return A.Hash > B.Hash;
+        });
+
+        const float SpacingSquared = FMath::Square(Spacing);
+        TMap<FIntVector, TArray<FVector3f, TInlineAllocator<2>>> KeptCells;
+
+        for (const FScatterCandidate& Candidate : Candidates)
+        {
+            const FIntVector Cell(
+                FMath::FloorToInt(Candidate.Position.X / Spacing),
+                FMath::FloorToInt(Candidate.Position.Y / Spacing),
+                FMath::FloorToInt(Candidate.Position.Z / Spacing));
+
+            bool bBlocked = false;
+            for (int32 dz = -1; dz <= 1 && !bBlocked; dz++)
+            {
+                for (int32 dy = -1; dy <= 1 && !bBlocked; dy++)
+                {
+                    for (int32 dx = -1; dx <= 1 && !bBlocked; dx++)
+                    {
+                        if (const TArray<FVector3f, TInlineAllocator<2>>* Kept = KeptCells.Find(Cell + FIntVector(dx, dy, dz)))
+                        {
+                            for (const FVector3f& KeptPosition : *Kept)
+                            {
+                                if (FVector3f::DistSquared(KeptPosition, Candidate.Position) < SpacingSquared)
+                                {
+                                    bBlocked = true;
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+
+            if (bBlocked)
+            {
+                continue;
+            }
+
+            KeptCells.FindOrAdd(Cell).Add(Candidate.Position);
+
+            // Thin after spacing, so sparse cover stays evenly spread instead of clumping
+            if (HashToUnit(MixHash(Candidate.Hash ^ 0x3)) >= Rule.Coverage)
+            {
+                continue;
+            }
+
+            const FVector Up = FVector(Rule.bAlignToSurface ? Candidate.Normal : Candidate.Position.GetSafeNormal());
+            const float Yaw = HashToUnit(MixHash(Candidate.Hash ^ 0x4)) * UE_TWO_PI;
+            const FQuat Rotation = FQuat(Up, Yaw) * FRotationMatrix::MakeFromZ(Up).ToQuat();
+            const float Scale = FMath::Lerp(Rule.MinScale, Rule.MaxScale, HashToUnit(MixHash(Candidate.Hash ^ 0x5)));
+
+            Instances.Add(FTransform(Rotation, FVector(Candidate.Position), FVector(Scale)));
+        }
+    }
+}
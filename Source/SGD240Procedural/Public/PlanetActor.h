@@ -2,10 +2,40 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
-#include "ProceduralMeshComponent.h"
+#include "Async/Future.h"
 #include "MarchingCubesTable.h"
+#include "PlanetChunk.h"
+#include "PlanetEditLog.h"
+#include "PlanetNoiseVolume.h"
+#include "PlanetScatter.h"
 #include "PlanetActor.generated.h"
 
+class UPlanetMeshComponent;
+class UHierarchicalInstancedStaticMeshComponent;
+struct FPlanetMeshSection;
+struct FPlanetGenerationPass;
+struct FPlanetMemoryUsage;
+struct FPlanetEvictionCandidate;
+
+// Result of a raycast against the planet density field
+USTRUCT(BlueprintType)
+struct FPlanetRayHit
+{
+ GENERATED_BODY()
+
+ UPROPERTY(BlueprintReadOnly, Category = "Planet Queries")
+ bool bHit = false;
+
+ UPROPERTY(BlueprintReadOnly, Category = "Planet Queries")
+ FVector Location = FVector::ZeroVector;
+
+ UPROPERTY(BlueprintReadOnly, Category = "Planet Queries")
+ FVector Normal = FVector::ZeroVector;
+
+ UPROPERTY(BlueprintReadOnly, Category = "Planet Queries")
+ float Distance = 0.0f;
+};
+
 // Define FVoxel struct to store corner positions and values
 struct FVoxel
 {
@@ -26,26 +56,237 @@ protected:
  // Called when the game starts or when spawned
  virtual void BeginPlay() override;
 
+ virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 public:
  // Called every frame
  virtual void Tick(float DeltaTime) override;
-    
+
+ virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet Settings")
  UMaterialInterface* PlanetMaterial;
 
+ // Records a brush edit at a world location and replicates it to clients. Server only.
+ UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly, Category = "Planet Editing")
+ void ApplyBrush(const FVector& WorldLocation, float BrushRadius, float Strength, EPlanetBrushMode Mode);
+
+ // Density field queries. These read the density samples directly instead of the collision mesh,
+ // are safe to call from any thread, and positions and directions are in world space. Each call
+ // reads one published snapshot, so edits landing mid-query are never half seen.
+ UFUNCTION(BlueprintCallable, Category = "Planet Queries")
+ float SampleDensity(const FVector& WorldLocation) const;
+
+ UFUNCTION(BlueprintCallable, Category = "Planet Queries")
+ FVector SampleGradient(const FVector& WorldLocation) const;
+
+ // Outward surface normal, i.e. the normalised negative density gradient
+ UFUNCTION(BlueprintCallable, Category = "Planet Queries")
+ FVector GetSurfaceNormal(const FVector& WorldLocation) const;
+
+ // Projects a point onto the surface. Returns false if it did not converge.
+ UFUNCTION(BlueprintCallable, Category = "Planet Queries")
+ bool FindClosestSurfacePoint(const FVector& WorldLocation, FVector& OutSurfacePoint) const;
+
+ // Sphere traces the density field along a ray to the first surface crossing
+ UFUNCTION(BlueprintCallable, Category = "Planet Queries")
+ bool Raycast(const FVector& Start, const FVector& Direction, float MaxDistance, FPlanetRayHit& OutHit) const;
+
+ // Direction from a point towards the planet's centre
+ UFUNCTION(BlueprintCallable, Category = "Planet Queries")
+ FVector GetGravityDirection(const FVector& WorldLocation) const;
+
+ // Height above the surface measured along the gravity direction, negative when underground
+ UFUNCTION(BlueprintCallable, Category = "Planet Queries")
+ float GetAltitude(const FVector& WorldLocation) const;
+
+ // Batched variants, evaluated in parallel against a single snapshot. Output views must be the
+ // same size as the inputs.
+ void SampleDensityBatch(TArrayView<const FVector> WorldLocations, TArrayView<float> OutDensities) const;
+ void SampleGradientBatch(TArrayView<const FVector> WorldLocations, TArrayView<FVector> OutGradients) const;
+ void FindClosestSurfacePointBatch(TArrayView<const FVector> WorldLocations, TArrayView<FVector> OutSurfacePoints, TArrayView<bool> OutConverged) const;
+ void RaycastBatch(TArrayView<const FVector> Starts, TArrayView<const FVector> Directions, float MaxDistance, TArrayView<FPlanetRayHit> OutHits) const;
+
+ // Called by the replicated edit log and baked snapshot as data arrives on clients
+ void HandleReplicatedBrushOp(const FPlanetBrushOp& Op);
+ void HandleReplicatedBakedPiece(const FPlanetBakedPiece& Piece);
+
+ // Memory accounting and eviction, driven by UPlanetMemorySubsystem
+ void GetMemoryUsage(FPlanetMemoryUsage& OutUsage) const;
+ void GetEvictionCandidates(double ViewedBefore, TArray<FPlanetEvictionCandidate>& OutCandidates);
+ SIZE_T EvictChunk(int32 ChunkIndex, bool bMesh); // Returns the bytes freed
+
+ // Times meshing and sampling the resident chunks against linear-order equivalents, run by planet.BenchmarkMeshing
+ void RunMeshingBenchmark(int32 Iterations, FOutputDevice& Ar) const;
+
 private:
  UPROPERTY(EditAnywhere, Category = "Planets")
- UProceduralMeshComponent* PlanetMesh;
+ UPlanetMeshComponent* PlanetMesh;
 
  UPROPERTY(EditAnywhere, Category = "Planets")
  float Radius;
 
+ UPROPERTY(EditAnywhere, Category = "Planets", meta = (ClampMin = "2"))
+ int32 GridSize; // Size of bounds for voxel grid (increase for more detail)
+
+ UPROPERTY(EditAnywhere, Category = "Planets", meta = (ClampMin = "1.0"))
+ float VoxelSize; // Size of each voxel - lower means more detail
+
+ UPROPERTY(EditAnywhere, Category = "Planets", meta = (ClampMin = "4", ClampMax = "64"))
+ int32 ChunkSize; // Cells per chunk along each axis, each chunk is one mesh section. Rounded down to a power of two.
+
+ // Show a coarse planet immediately, then swap in finer passes built in the background
+ UPROPERTY(EditAnywhere, Category = "Planets")
+ bool bProgressiveGeneration;
+
+ // Grid size of the first pass, doubled for each later pass until GridSize is reached
+ UPROPERTY(EditAnywhere, Category = "Planets", meta = (ClampMin = "2", EditCondition = "bProgressiveGeneration"))
+ int32 ProgressiveStartGridSize;
+
+ UPROPERTY(EditAnywhere, Category = "Planets")
+ float NoiseScale;
+
+ UPROPERTY(EditAnywhere, Category = "Planets")
+ float NoiseAmplitude; // Noise Strength
+
+ // Offsets the noise, 0 keeps the original planet
+ UPROPERTY(EditAnywhere, Category = "Planets")
+ int32 NoiseSeed;
+
+ // Sample noise from a baked lookup volume instead of calling PerlinNoise3D for every sample
+ UPROPERTY(EditAnywhere, Category = "Planets")
+ bool bUseNoiseVolume;
+
+ // Volume samples per unit of noise space. Higher is more accurate and uses cubically more memory.
+ UPROPERTY(EditAnywhere, Category = "Planets", meta = (ClampMin = "1", ClampMax = "32", EditCondition = "bUseNoiseVolume"))
+ int32 NoiseVolumeResolution;
+
+ UPROPERTY(EditAnywhere, Category = "Planets", meta = (EditCondition = "bUseNoiseVolume"))
+ EPlanetNoiseFilter NoiseVolumeFilter;
+
+ // Instanced meshes scattered over the full resolution surface. After edits only the changed
+ // chunks are scattered again.
+ UPROPERTY(EditAnywhere, Category = "Planet Scatter")
+ TArray<FPlanetScatterRule> ScatterRules;
+
+ // One per chunk per rule at ChunkIndex * ScatterRules.Num() + RuleIndex, null until it gets instances
+ UPROPERTY(Transient)
+ TArray<UHierarchicalInstancedStaticMeshComponent*> ScatterComponents;
+
+ // Chunks within this distance of any player's viewpoint count as viewed, so they're kept resident
+ // and have their meshes rebuilt if they were evicted
+ UPROPERTY(EditAnywhere, Category = "Planet Memory", meta = (ClampMin = "0.0"))
+ float ChunkViewDistance;
+
+ // Number of brush ops kept in the replicated log before they are baked into chunk deltas
+ UPROPERTY(EditAnywhere, Category = "Planet Editing", meta = (ClampMin = "1"))
+ int32 MaxEditLogOps;
+
+ // Largest brush the server will apply. Requests from clients are clamped to these, so one brush
+ // can't dirty the whole planet or flood the edit log.
+ UPROPERTY(EditAnywhere, Category = "Planet Editing", meta = (ClampMin = "1.0"))
+ float MaxBrushRadius;
+
+ UPROPERTY(EditAnywhere, Category = "Planet Editing", meta = (ClampMin = "0.0"))
+ float MaxBrushStrength;
+
+ UPROPERTY(Replicated)
+ FPlanetEditLog EditLog;
+
+ UPROPERTY(Replicated)
+ FPlanetBakedEdits BakedEdits;
+
+ // Every op up to and including this sequence is folded into BakedEdits
+ UPROPERTY(ReplicatedUsing = OnRep_BakedSequence)
+ uint32 BakedSequence;
+
+ UFUNCTION()
+ void OnRep_BakedSequence();
+
+ // Upper bound on how fast density changes per unit distance, used to size sphere tracing steps.
+ // Raise it if raycasts tunnel through thin features.
+ UPROPERTY(EditAnywhere, Category = "Planet Queries", meta = (ClampMin = "1.0"))
+ float DensityLipschitz;
+
+ TArray<FPlanetChunk> Chunks; // Full resolution density field, empty until the final pass lands. Game thread only.
+ FPlanetGridLayout Layout;
+ uint32 AppliedSequence; // Last brush op applied to the local density field
+ uint32 IssuedSequence;  // Last brush op recorded by the server
+
+ // Only assigned on the game thread while no generation pass is running
+ TSharedPtr<const FPlanetNoiseVolume, ESPMode::ThreadSafe> NoiseVolume;
+ bool bNoiseVolumeBaked; // True once a bake has been tried, even if the volume was refused for its size
+ FVector NoiseOffset;
+
+ TArray<int32> PendingPassGridSizes;
+ TFuture<void> GenerationTask;
+ std::atomic<bool> bGenerationCancelled; // Set on the game thread, polled by workers so EndPlay doesn't wait on a whole pass
+
+ // Dirty chunks are re-polygonised on a worker from a snapshot, one batch at a time
+ TFuture<void> MeshTask;
+ bool bMeshTaskRunning;
+
+ // Latest published state of Chunks for readers on other threads. DensityLock is only held long
+ // enough to copy or swap the pointer, never while sampling or editing.
+ TSharedPtr<const FPlanetDensitySnapshot, ESPMode::ThreadSafe> DensitySnapshot;
+ mutable FRWLock DensityLock;
+ bool bSnapshotStale; // True if Chunks or the transform changed since the last publish
+ bool bCollisionStale; // True if mesh sections were evicted since collision was last cooked
+ double LastCollisionCookTime;
+
+ // Recooks the collision body from every section. Evictions only mark it stale, so it's cooked at most
+ // every planet.CollisionRecookInterval seconds, or with the next mesh batch if that comes first.
+ void CookCollision();
+
+ void PublishDensitySnapshot();
+ TSharedPtr<const FPlanetDensitySnapshot, ESPMode::ThreadSafe> GetDensitySnapshot() const;
+
+ // Returns the chunk's data ready to modify, copying it first if a snapshot still holds it
+ FPlanetChunkData& EditChunkData(FPlanetChunk& Chunk);
+
+ // Regenerates an evicted chunk's density on the spot. Mesh rebuilds and viewed chunks are reloaded by
+ // the mesh worker instead, so this is only a fallback for edits landing on a chunk before that.
+ void EnsureChunkResident(FPlanetChunk& Chunk);
+ void ReloadChunkDensity(const FPlanetGridLayout& InLayout, const FIntVector& ChunkCoord, const FPlanetEvictedDensity* Evicted, TArray<float>& OutDensity) const;
+ const FPlanetChunkData* ReloadSnapshotChunk(const FPlanetDensitySnapshot& Snapshot, int32 ChunkIndex) const;
+ void AdoptReloadedChunks();
+ void UpdateChunkViewTimes();
+ SIZE_T GetSectionMemory(int32 SectionIndex, SIZE_T& OutCollisionBytes) const;
+
  void GeneratePlanet();
- void GenerateVoxelGrid(int GridSize, float VoxelSize, TArray<FVoxel>& OutVoxels);
- void AssignDensityValues(TArray<FVoxel>& Voxels, int GridSize, float VoxelSize);
+ FPlanetGridLayout MakeLayout(int32 PassGridSize) const;
+ void BuildGenerationPass(int32 PassGridSize, FPlanetGenerationPass& OutPass) const;
+ void ApplyGenerationPass(FPlanetGenerationPass& Pass);
+ void StartNextGenerationPass();
+ TSharedPtr<const FPlanetNoiseVolume, ESPMode::ThreadSafe> BakeNoiseVolume() const;
+
+ void GenerateVoxelGrid(const FPlanetGridLayout& InLayout, const FIntVector& ChunkCoord, const TArray<float>& Density, TArray<FVoxel>& OutVoxels) const;
+ void AssignDensityValues(const FPlanetGridLayout& InLayout, const FIntVector& ChunkCoord, TArray<float>& OutDensity) const;
+ float SampleBaseDensity(const FVector& Position, const FPlanetNoiseVolume* Volume) const;
 
  // Declare MarchingCubes function with the correct signature
- void MarchingCubes(TArray<FVoxel>& Voxels, TArray<FVector>& Vertices, TArray<int32>& Triangles, int GridSize, float VoxelSize);
+ void MarchingCubes(const TArray<FVoxel>& Voxels, TArray<FVector>& Vertices, TArray<int32>& Triangles) const;
+
+ // Marches a chunk's samples directly, one z slice at a time, reusing shared corners between cells
+ void MarchingCubes(const FPlanetGridLayout& InLayout, const FIntVector& ChunkCoord, const TArray<float>& Density, TArray<FVector>& Vertices, TArray<int32>& Triangles) const;
 
- FVector InterpolateEdge(const FVector& CornerA, const FVector& CornerB, float ValueA, float ValueB);
-};
\ No newline at end of file
+ FVector InterpolateEdge(const FVector& CornerA, const FVector& CornerB, float ValueA, float ValueB) const;
+
+ void PolygoniseChunk(const FPlanetDensitySnapshot& Snapshot, int32 ChunkIndex, FPlanetMeshSection& OutSection) const;
+ void RebuildDirtyChunks();
+ void ApplyChunkScatter(int32 ChunkIndex, FPlanetChunkScatter& Scatter);
+
+ // Sampling helpers in planet-local space. They only read the snapshot, so any thread can call them.
+ // Evicted edited chunks are rebuilt before they're sampled. Outside the grid and in evicted unedited
+ // chunks they fall back to the analytic density.
+ float SampleDensityLocal(const FPlanetDensitySnapshot& Snapshot, const FVector& LocalPosition) const;
+ FVector SampleGradientLocal(const FPlanetDensitySnapshot& Snapshot, const FVector& LocalPosition) const;
+ bool FindClosestSurfacePointLocal(const FPlanetDensitySnapshot& Snapshot, const FVector& LocalPosition, FVector& OutSurfacePoint) const;
+ bool RaycastLocal(const FPlanetDensitySnapshot& Snapshot, const FVector& LocalStart, const FVector& LocalDirection, float MaxDistance, FVector& OutHitPosition) const;
+
+ void ApplyBrushOp(const FPlanetBrushOp& Op);
+ void ApplyBrushOpToChunk(const FPlanetBrushOp& Op, FPlanetChunk& Chunk);
+ void ApplyPendingBrushOps();
+ void RefreshBakedChunk(int32 ChunkIndex);
+ void CompactEditLog();
+};
@@ -0,0 +1,194 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+
+class FPlanetNoiseVolume;
+
+// One version of a chunk's density samples. A published version is never modified again:
+// writers copy it, edit the copy and publish that as the next version, so a snapshot holding the
+// old one can keep reading it on any thread without locks.
+struct FPlanetChunkData
+{
+ TArray<float> Density; // Corner samples in the order given by FPlanetChunk::SampleIndex
+ uint32 Version = 0;    // Bumped on every change, so readers can tell which version they meshed
+};
+
+// What's kept of an edited chunk while its density is evicted. Like FPlanetChunkData it's never
+// modified once published, so readers on any thread can rebuild the chunk from it.
+struct FPlanetEvictedDensity
+{
+ TArray<uint8> CompressedDelta; // Copy of the chunk's baked delta, see FPlanetBakedEdits
+ uint32 Version = 0;            // Version of the data that was evicted
+};
+
+// Edited chunks rebuilt by queries while their density was evicted, shared by every copy of a
+// snapshot so each chunk is only rebuilt once. The game thread adopts them back into the planet.
+struct FPlanetReloadedChunks
+{
+ FCriticalSection Lock;
+ TMap<int32, TSharedPtr<FPlanetChunkData, ESPMode::ThreadSafe>> Chunks;
+};
+
+// A cubic block of the planet's density field. A chunk covering ChunkSize cells stores
+// (ChunkSize + 1)^3 corner samples, so neighbouring chunks duplicate their shared face and
+// each chunk can be re-polygonised on its own after an edit. ChunkSize is a power of two.
+struct FPlanetChunk
+{
+ FIntVector Coord = FIntVector::ZeroValue; // Chunk coordinate within the planet grid
+ TSharedPtr<FPlanetChunkData, ESPMode::ThreadSafe> Data; // Latest version, may also be held by snapshots. Null while evicted.
+ TSharedPtr<const FPlanetEvictedDensity, ESPMode::ThreadSafe> Evicted; // Set while an edited chunk's density is evicted
+
+ uint32 BakedSequence = 0;   // Sequence of the baked edit snapshot currently applied
+ uint32 MeshedVersion = 0;   // Data version the current mesh section was built from
+ double LastViewedTime = 0.0; // World time a player last had the chunk within view distance
+ bool bEdited = false;        // True once any brush op has touched this chunk
+ bool bEditedSinceBake = false; // True if brush ops have been applied since the last bake
+ bool bMeshEvicted = false;   // True while the mesh section, collision and scatter are dropped to save memory
+
+ // MeshedVersion of a chunk whose mesh has to be rebuilt whatever version its data is at
+ static constexpr uint32 UnmeshedVersion = MAX_uint32;
+
+ // Index of a sample within a chunk. The ChunkSize^3 core is stored in Morton (Z-order), so the
+ // eight corners of a cell and its neighbours sit a few cache lines apart instead of whole rows and
+ // slices apart. The one-sample apron on the upper faces, shared with the next chunk, follows it
+ // as three flat slabs: x == ChunkSize, then y == ChunkSize, then z == ChunkSize.
+ static FORCEINLINE int32 SampleIndex(int32 X, int32 Y, int32 Z, int32 CellsPerAxis)
+ {
+  if (X < CellsPerAxis && Y < CellsPerAxis && Z < CellsPerAxis)
+  {
+   return static_cast<int32>(FMath::MortonCode3(X) | (FMath::MortonCode3(Y) << 1) | (FMath::MortonCode3(Z) << 2));
+  }
+
+  const int32 SamplesPerAxis = CellsPerAxis + 1;
+  const int32 ApronStart = CellsPerAxis * CellsPerAxis * CellsPerAxis;
+  if (X == CellsPerAxis)
+  {
+   return ApronStart + Y + Z * SamplesPerAxis;
+  }
+  if (Y == CellsPerAxis)
+  {
+   return ApronStart + SamplesPerAxis * SamplesPerAxis + X + Z * CellsPerAxis;
+  }
+  return ApronStart + SamplesPerAxis * SamplesPerAxis + CellsPerAxis * SamplesPerAxis + X + Y * CellsPerAxis;
+ }
+};
+
+// How a planet's grid is split into chunks. Each generation pass has its own layout, so coarse
+// preview passes cover the same space as the final grid with fewer, larger voxels.
+struct FPlanetGridLayout
+{
+ int32 ChunkSize = 32;     // Cells per chunk along each axis
+ int32 ChunksPerAxis = 0;
+ float VoxelSize = 16.0f;
+
+ FORCEINLINE int32 GetNumChunks() const
+ {
+  return ChunksPerAxis * ChunksPerAxis * ChunksPerAxis;
+ }
+
+ // Planet-local position of a chunk sample, with the grid centred around (0, 0, 0)
+ FORCEINLINE FVector GetSamplePosition(const FIntVector& ChunkCoord, int32 X, int32 Y, int32 Z) const
+ {
+  const FVector GridCenterOffset = FVector(ChunksPerAxis * ChunkSize / 2.0f) * VoxelSize;
+
+  const FIntVector Sample = ChunkCoord * ChunkSize + FIntVector(X, Y, Z);
+  return FVector(Sample) * VoxelSize - GridCenterOffset;
+ }
+
+ FORCEINLINE FBox GetChunkBounds(const FIntVector& ChunkCoord) const
+ {
+  return FBox(GetSamplePosition(ChunkCoord, 0, 0, 0), GetSamplePosition(ChunkCoord, ChunkSize, ChunkSize, ChunkSize));
+ }
+
+ FORCEINLINE int32 GetChunkIndex(const FIntVector& ChunkCoord) const
+ {
+  return ChunkCoord.X + (ChunkCoord.Y + ChunkCoord.Z * ChunksPerAxis) * ChunksPerAxis;
+ }
+
+ FORCEINLINE FIntVector GetChunkCoord(int32 ChunkIndex) const
+ {
+  return FIntVector(ChunkIndex % ChunksPerAxis, (ChunkIndex / ChunksPerAxis) % ChunksPerAxis, ChunkIndex / (ChunksPerAxis * ChunksPerAxis));
+ }
+};
+
+// Immutable view of a planet's density field at one moment. Taking one only copies the chunk
+// pointers, and it stays valid and unchanged however many edits are published after it.
+struct FPlanetDensitySnapshot
+{
+ FPlanetGridLayout Layout;
+ TArray<TSharedPtr<const FPlanetChunkData, ESPMode::ThreadSafe>> Chunks; // Indexed like the planet's chunks
+ TArray<TSharedPtr<const FPlanetEvictedDensity, ESPMode::ThreadSafe>> Evicted; // Evicted edited chunks, which readers rebuild before sampling
+ TSharedPtr<FPlanetReloadedChunks, ESPMode::ThreadSafe> Reloaded;    // Null if the snapshot wasn't published by a planet
+ TSharedPtr<const FPlanetNoiseVolume, ESPMode::ThreadSafe> NoiseVolume;   // For the analytic density outside the grid
+ FTransform Transform; // Actor transform when the snapshot was published
+
+ void SetChunks(const TArray<FPlanetChunk>& InChunks)
+ {
+  Chunks.Reset(InChunks.Num());
+  Evicted.Reset(InChunks.Num());
+  for (const FPlanetChunk& Chunk : InChunks)
+  {
+   Chunks.Add(Chunk.Data);
+   Evicted.Add(Chunk.Evicted);
+  }
+ }
+
+ // Finds the chunk and cell containing a planet-local position. Returns false outside the grid.
+ bool FindCell(const FVector& Position, int32& OutChunkIndex, FIntVector& OutLocal, FVector& OutAlpha) const
+ {
+  const int32 CellsPerAxis = Layout.ChunksPerAxis * Layout.ChunkSize;
+  const FVector GridPosition = Position / Layout.VoxelSize + FVector(CellsPerAxis / 2.0f);
+
+  if (Chunks.Num() != Layout.GetNumChunks() ||
+   GridPosition.X < 0 || GridPosition.Y < 0 || GridPosition.Z < 0 ||
+   GridPosition.X >= CellsPerAxis || GridPosition.Y >= CellsPerAxis || GridPosition.Z >= CellsPerAxis)
+  {
+   return false;
+  }
+
+  const FIntVector Cell(FMath::FloorToInt(GridPosition.X), FMath::FloorToInt(GridPosition.Y), FMath::FloorToInt(GridPosition.Z));
+  OutAlpha = GridPosition - FVector(Cell);
+
+  // Chunks duplicate their upper face, so all eight corners of a cell live in one chunk
+  const FIntVector ChunkCoord = Cell / Layout.ChunkSize;
+  OutLocal = Cell - ChunkCoord * Layout.ChunkSize;
+  OutChunkIndex = Layout.GetChunkIndex(ChunkCoord);
+  return true;
+ }
+
+ // Trilinearly samples the chunk data at a planet-local position. Returns false outside the grid
+ // or in a chunk that was evicted when the snapshot was taken.
+ bool SampleDensity(const FVector& Position, float& OutDensity) const
+ {
+  int32 ChunkIndex;
+  FIntVector Local;
+  FVector Alpha;
+  const FPlanetChunkData* Chunk = FindCell(Position, ChunkIndex, Local, Alpha) ? Chunks[ChunkIndex].Get() : nullptr;
+  if (!Chunk)
+  {
+   return false;
+  }
+
+  OutDensity = SampleChunk(*Chunk, Local, Alpha);
+  return true;
+ }
+
+ // Trilinearly samples one cell of a chunk, as found by FindCell
+ float SampleChunk(const FPlanetChunkData& Chunk, const FIntVector& Local, const FVector& Alpha) const
+ {
+  const int32 N = Layout.ChunkSize;
+  const float* D = Chunk.Density.GetData();
+  const auto Load = [D, N, &Local](int32 dx, int32 dy, int32 dz)
+  {
+   return D[FPlanetChunk::SampleIndex(Local.X + dx, Local.Y + dy, Local.Z + dz, N)];
+  };
+
+  const float X00 = FMath::Lerp(Load(0, 0, 0), Load(1, 0, 0), Alpha.X);
+  const float X10 = FMath::Lerp(Load(0, 1, 0), Load(1, 1, 0), Alpha.X);
+  const float X01 = FMath::Lerp(Load(0, 0, 1), Load(1, 0, 1), Alpha.X);
+  const float X11 = FMath::Lerp(Load(0, 1, 1), Load(1, 1, 1), Alpha.X);
+
+  return FMath::Lerp(FMath::Lerp(X00, X10, Alpha.Y), FMath::Lerp(X01, X11, Alpha.Y), Alpha.Z);
+ }
+};
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/NetSerialization.h"
+#include "Net/Serialization/FastArraySerializer.h"
+#include "PlanetEditLog.generated.h"
+
+class APlanetActor;
+
+UENUM(BlueprintType)
+enum class EPlanetBrushMode : uint8
+{
+ Add,    // Raises density, building terrain up
+ Remove  // Lowers density, digging into terrain
+};
+
+// A single terrain edit. Every field is quantised before it is applied on the server, so
+// clients replaying the op against their own density field get bit-identical results.
+USTRUCT()
+struct FPlanetBrushOp : public FFastArraySerializerItem
+{
+ GENERATED_BODY()
+
+ UPROPERTY()
+ uint32 Sequence = 0;
+
+ // Planet-local centre, rounded to whole units so it survives FVector_NetQuantize unchanged
+ UPROPERTY()
+ FVector_NetQuantize Center = FVector::ZeroVector;
+
+ UPROPERTY()
+ uint16 Radius = 0;
+
+ // Density change at the centre of the brush, falling off smoothly to zero at Radius
+ UPROPERTY()
+ uint16 Strength = 0;
+
+ UPROPERTY()
+ EPlanetBrushMode Mode = EPlanetBrushMode::Add;
+
+ FBox GetBounds() const;
+ float Apply(const FVector& Position, float Density) const;
+
+ void PostReplicatedAdd(const struct FPlanetEditLog& InArraySerializer);
+};
+
+// Ordered log of brush ops since the last bake, delta-replicated so each op is only sent once
+USTRUCT()
+struct FPlanetEditLog : public FFastArraySerializer
+{
+ GENERATED_BODY()
+
+ UPROPERTY()
+ TArray<FPlanetBrushOp> Ops;
+
+ APlanetActor* Owner = nullptr;
+
+ const FPlanetBrushOp* FindOp(uint32 Sequence) const;
+
+ bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+ {
+  return FFastArraySerializer::FastArrayDeltaSerialize<FPlanetBrushOp, FPlanetEditLog>(Ops, DeltaParms, *this);
+ }
+};
+
+template<>
+struct TStructOpsTypeTraits<FPlanetEditLog> : public TStructOpsTypeTraitsBase2<FPlanetEditLog>
+{
+ enum { WithNetDeltaSerializer = true };
+};
+
+// One piece of a compressed, quantised density delta for a chunk. Deltas are split into pieces
+// so that no replicated array exceeds the net array size limit.
+USTRUCT()
+struct FPlanetBakedPiece : public FFastArraySerializerItem
+{
+ GENERATED_BODY()
+
+ UPROPERTY()
+ int32 ChunkIndex = INDEX_NONE;
+
+ // Last brush op folded into this delta
+ UPROPERTY()
+ uint32 Sequence = 0;
+
+ // 16 bits, since a poorly compressing 64-cell chunk can take more than 255 pieces
+ UPROPERTY()
+ uint16 PieceIndex = 0;
+
+ UPROPERTY()
+ uint16 NumPieces = 0;
+
+ UPROPERTY()
+ TArray<uint8> Data;
+
+ void PostReplicatedAdd(const struct FPlanetBakedEdits& InArraySerializer);
+ void PostReplicatedChange(const struct FPlanetBakedEdits& InArraySerializer);
+};
+
+// Compacted snapshot of every edited chunk, used to catch up late joiners without the full log
+USTRUCT()
+struct FPlanetBakedEdits : public FFastArraySerializer
+{
+ GENERATED_BODY()
+
+ UPROPERTY()
+ TArray<FPlanetBakedPiece> Pieces;
+
+ APlanetActor* Owner = nullptr;
+
+ // Size of one density step in the quantised delta
+ static constexpr float DeltaQuantum = 1.0f / 16.0f;
+ static constexpr int32 MaxPieceSize = 1024;
+
+ // Replaces the pieces stored for a chunk with a new compressed delta. Returns false, keeping the old
+ // pieces, if it can't be compressed or needs more pieces than NumPieces can count.
+ bool SetChunkDelta(int32 ChunkIndex, uint32 Sequence, const TArray<int16>& QuantisedDelta);
+
+ // Reassembles the newest complete delta for a chunk. Returns false if pieces are still missing.
+ bool GetChunkDelta(int32 ChunkIndex, int32 NumSamples, uint32& OutSequence, TArray<int16>& OutQuantisedDelta) const;
+
+ // Same, but leaves the delta compressed, so it can be kept cheaply and decompressed on any thread
+ bool GetCompressedChunkDelta(int32 ChunkIndex, uint32& OutSequence, TArray<uint8>& OutCompressed) const;
+ static bool UncompressChunkDelta(const TArray<uint8>& Compressed, int32 NumSamples, TArray<int16>& OutQuantisedDelta);
+
+ bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+ {
+  return FFastArraySerializer::FastArrayDeltaSerialize<FPlanetBakedPiece, FPlanetBakedEdits>(Pieces, DeltaParms, *this);
+ }
+};
+
+template<>
+struct TStructOpsTypeTraits<FPlanetBakedEdits> : public TStructOpsTypeTraitsBase2<FPlanetBakedEdits>
+{
+ enum { WithNetDeltaSerializer = true };
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "PlanetMemorySubsystem.generated.h"
+
+class APlanetActor;
+
+// Bytes held by one planet's chunks, or by every planet, split by what they're spent on
+struct FPlanetMemoryUsage
+{
+ SIZE_T DensityBytes = 0;    // Resident density samples
+ SIZE_T MeshBytes = 0;       // CPU sections plus an estimate of their GPU buffers
+ SIZE_T CollisionBytes = 0;  // Estimate of the collision triangles cooked from the sections
+ SIZE_T BakedEditBytes = 0;  // Compressed edit deltas, replicated and copied for evicted edited chunks. Never evicted.
+ int32 NumChunks = 0;
+ int32 NumDensityEvicted = 0;
+ int32 NumMeshEvicted = 0;
+
+ SIZE_T GetTotalBytes() const
+ {
+  return DensityBytes + MeshBytes + CollisionBytes + BakedEditBytes;
+ }
+
+ FPlanetMemoryUsage& operator+=(const FPlanetMemoryUsage& Other);
+};
+
+// A piece of chunk data a planet could free, and when the chunk was last viewed
+struct FPlanetEvictionCandidate
+{
+ APlanetActor* Planet = nullptr;
+ int32 ChunkIndex = INDEX_NONE;
+ bool bMesh = false; // Frees the mesh section, its collision and scatter rather than the density samples
+ double LastViewedTime = 0.0;
+};
+
+// Keeps the chunk data of every planet in the world within planet.MemoryBudgetMB. Over budget, the
+// least recently viewed chunks are evicted: their density samples first, which leaves the planet
+// looking the same, then their meshes. Evicted density is regenerated from the planet's parameters,
+// plus the chunk's compressed baked delta if it was edited. Density edited since the last bake is
+// kept until the next one. Usage is shown by "stat Planet" and logged per planet by planet.MemoryReport.
+UCLASS()
+class SGD240PROCEDURAL_API UPlanetMemorySubsystem : public UTickableWorldSubsystem
+{
+ GENERATED_BODY()
+
+public:
+ void RegisterPlanet(APlanetActor* Planet);
+ void UnregisterPlanet(APlanetActor* Planet);
+
+ FPlanetMemoryUsage GetTotalUsage() const;
+ void DumpReport(FOutputDevice& Ar) const;
+
+ //~ Begin FTickableGameObject Interface
+ virtual void Tick(float DeltaTime) override;
+ virtual TStatId GetStatId() const override;
+ //~ End FTickableGameObject Interface
+
+protected:
+ virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+ TArray<TWeakObjectPtr<APlanetActor>> Planets;
+};
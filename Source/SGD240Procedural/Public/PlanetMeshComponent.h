@@ -0,0 +1,86 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/MeshComponent.h"
+#include "Interfaces/Interface_CollisionDataProvider.h"
+#include "PlanetMeshComponent.generated.h"
+
+class UBodySetup;
+
+// Compact vertex for planet chunks, 10 bytes instead of the ~150 bytes of an FProcMeshVertex
+struct FPlanetPackedVertex
+{
+ uint16 Position[3]; // Quantised across the section bounds
+ int16 Normal[2];    // Octahedral encoded unit normal
+};
+
+// Mesh data for one chunk. Positions are stored relative to the chunk bounds, so Bounds must be
+// set before any vertices are added.
+struct SGD240PROCEDURAL_API FPlanetMeshSection
+{
+ FBox Bounds = FBox(ForceInit);
+ TArray<FPlanetPackedVertex> Vertices;
+ TArray<uint32> Indices;
+
+ void AddVertex(const FVector& Position, const FVector& Normal);
+ FVector3f UnpackPosition(const FPlanetPackedVertex& Vertex) const;
+ static FVector3f UnpackNormal(const FPlanetPackedVertex& Vertex);
+
+ SIZE_T GetAllocatedSize() const;
+};
+
+// Lightweight replacement for UProceduralMeshComponent for planet chunks. Each chunk is a section
+// that can be replaced on its own without recreating the scene proxy or any other section's buffers.
+UCLASS(ClassGroup = Rendering, meta = (BlueprintSpawnableComponent))
+class SGD240PROCEDURAL_API UPlanetMeshComponent : public UMeshComponent, public IInterface_CollisionDataProvider
+{
+ GENERATED_BODY()
+
+public:
+ UPlanetMeshComponent(const FObjectInitializer& ObjectInitializer);
+
+ void SetChunkSection(int32 SectionIndex, FPlanetMeshSection&& Section);
+ void ClearChunkSection(int32 SectionIndex);
+
+ const FPlanetMeshSection* GetChunkSection(int32 SectionIndex) const;
+ int32 GetNumChunkSections() const { return Sections.Num(); }
+
+ // Rebuilds the collision body from every section. Call once after a batch of section updates.
+ void UpdateCollision();
+
+ // Cook collision off the game thread in game worlds
+ UPROPERTY(EditAnywhere, Category = "Planet Mesh")
+ bool bUseAsyncCooking;
+
+ //~ Begin IInterface_CollisionDataProvider Interface
+ virtual bool GetPhysicsTriMeshData(struct FTriMeshCollisionData* CollisionData, bool InUseAllTriData) override;
+ virtual bool ContainsPhysicsTriMeshData(bool InUseAllTriData) const override;
+ virtual bool WantsNegXTriMesh() override { return false; }
+ //~ End IInterface_CollisionDataProvider Interface
+
+ //~ Begin UPrimitiveComponent Interface
+ virtual FPrimitiveSceneProxy* CreateSceneProxy() override;
+ virtual UBodySetup* GetBodySetup() override;
+ virtual int32 GetNumMaterials() const override;
+ //~ End UPrimitiveComponent Interface
+
+ //~ Begin USceneComponent Interface
+ virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
+ //~ End USceneComponent Interface
+
+private:
+ TArray<FPlanetMeshSection> Sections;
+ FBox LocalBounds;
+
+ UPROPERTY(Instanced)
+ UBodySetup* BodySetup;
+
+ // Body setups still cooking, newest last
+ UPROPERTY(Transient)
+ TArray<UBodySetup*> AsyncBodySetupQueue;
+
+ void UpdateLocalBounds();
+ void SendSectionToProxy(int32 SectionIndex);
+ UBodySetup* CreateBodySetupHelper();
+ void FinishPhysicsAsyncCook(bool bSuccess, UBodySetup* FinishedBodySetup);
+};
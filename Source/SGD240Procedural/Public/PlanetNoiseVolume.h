@@ -0,0 +1,56 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PlanetNoiseVolume.generated.h"
+
+UENUM(BlueprintType)
+enum class EPlanetNoiseFilter : uint8
+{
+ Trilinear, // 8 loads per sample
+ Tricubic   // 64 loads per sample, Catmull-Rom, much closer to the analytic noise
+};
+
+// How far a baked volume strays from FMath::PerlinNoise3D and how long each lookup takes against
+// calling it, measured at random points when baked
+struct FPlanetNoiseVolumeReport
+{
+ float TrilinearMax = 0.0f;
+ float TrilinearRms = 0.0f;
+ float TricubicMax = 0.0f;
+ float TricubicRms = 0.0f;
+ float AnalyticNs = 0.0f;  // Per PerlinNoise3D call
+ float TrilinearNs = 0.0f; // Per sample
+ float TricubicNs = 0.0f;
+};
+
+// PerlinNoise3D baked into a quantised lookup volume over a box in noise space. Immutable once
+// baked, so any number of threads can sample it. Volumes are cached and shared by every planet
+// that asks for the same box and resolution, i.e. the same seed, scale and grid bounds.
+class SGD240PROCEDURAL_API FPlanetNoiseVolume
+{
+public:
+ // Returns the cached volume covering [NoiseMin, NoiseMax], baking it if nobody holds one yet.
+ // Returns null if the volume would be bigger than planet.MaxNoiseVolumeMB.
+ static TSharedPtr<const FPlanetNoiseVolume, ESPMode::ThreadSafe> FindOrBake(const FVector& NoiseMin, const FVector& NoiseMax, int32 SamplesPerUnit);
+
+ // Samples the volume at a noise-space position. Returns false outside the baked box.
+ bool Sample(const FVector& NoisePosition, EPlanetNoiseFilter Filter, float& OutNoise) const;
+
+ const FPlanetNoiseVolumeReport& GetReport() const { return Report; }
+ SIZE_T GetAllocatedSize() const { return Samples.GetAllocatedSize(); }
+
+private:
+ FIntVector MinSample = FIntVector::ZeroValue; // Noise-space position of the first sample, in samples
+ FIntVector Dimensions = FIntVector::ZeroValue;
+ int32 SamplesPerUnit = 1;
+ TArray<int16> Samples; // Noise quantised from [-1, 1], x fastest then y then z
+ FPlanetNoiseVolumeReport Report;
+
+ void Bake();
+ void Measure();
+
+ FORCEINLINE float Load(int32 X, int32 Y, int32 Z) const
+ {
+  return Samples[X + (Y + Z * Dimensions.Y) * Dimensions.X] * (1.0f / MAX_int16);
+ }
+};
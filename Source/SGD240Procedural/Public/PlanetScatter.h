@@ -0,0 +1,74 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PlanetScatter.generated.h"
+
+class UStaticMesh;
+struct FPlanetMeshSection;
+
+// One kind of instanced mesh scattered over the planet surface, e.g. trees or rocks
+USTRUCT(BlueprintType)
+struct FPlanetScatterRule
+{
+ GENERATED_BODY()
+
+ UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet Scatter")
+ UStaticMesh* Mesh = nullptr;
+
+ // Minimum distance between two instances of this rule
+ UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet Scatter", meta = (ClampMin = "10.0"))
+ float Spacing = 200.0f;
+
+ // Fraction of the evenly spaced points that get an instance. Lower for sparser, patchier cover.
+ UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet Scatter", meta = (ClampMin = "0.0", ClampMax = "1.0"))
+ float Coverage = 1.0f;
+
+ // Surface slope in degrees from the planet's up direction, 0 is flat ground and 90 a sheer cliff
+ UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet Scatter", meta = (ClampMin = "0.0", ClampMax = "180.0"))
+ float MinSlope = 0.0f;
+
+ UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet Scatter", meta = (ClampMin = "0.0", ClampMax = "180.0"))
+ float MaxSlope = 30.0f;
+
+ // Height above the planet radius, negative inside craters and caves
+ UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet Scatter")
+ float MinAltitude = -1000.0f;
+
+ UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet Scatter")
+ float MaxAltitude = 1000.0f;
+
+ UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet Scatter", meta = (ClampMin = "0.01"))
+ float MinScale = 0.8f;
+
+ UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet Scatter", meta = (ClampMin = "0.01"))
+ float MaxScale = 1.2f;
+
+ // Tilt instances to the surface normal instead of standing them up away from the planet's centre
+ UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet Scatter")
+ bool bAlignToSurface = false;
+
+ UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet Scatter")
+ bool bEnableCollision = false;
+
+ // Instances fade out beyond this distance, 0 never culls
+ UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Planet Scatter", meta = (ClampMin = "0"))
+ int32 CullDistance = 0;
+};
+
+// Scattered instances for one chunk in planet-local space, one array per rule
+struct FPlanetChunkScatter
+{
+ TArray<TArray<FTransform>> RuleInstances;
+};
+
+// Places scatter rules on polygonised chunks. Placement is blue noise: oversampled candidates on
+// the triangles, thinned by priority so no two instances of a rule are closer than its spacing.
+// Every random value is hashed from the candidate's triangle, so the same surface always gets the
+// same instances, and re-scattering a chunk after an edit only moves instances near the edit.
+class SGD240PROCEDURAL_API FPlanetScatter
+{
+public:
+ // Scatters every rule over a section. Slope and altitude come from the section's normals, which
+ // are the density gradient. Safe to call from any thread.
+ static void ScatterSection(const FPlanetMeshSection& Section, TArrayView<const FPlanetScatterRule> Rules, float PlanetRadius, int32 Seed, FPlanetChunkScatter& OutScatter);
+};
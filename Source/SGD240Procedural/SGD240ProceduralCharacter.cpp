@@ -10,6 +10,7 @@
 #include "EnhancedInputComponent.h"
 #include "EnhancedInputSubsystems.h"
 #include "InputActionValue.h"
+#include "PlanetActor.h"
 
 DEFINE_LOG_CATEGORY(LogTemplateCharacter);
 
@@ -127,4 +128,35 @@ void ASGD240ProceduralCharacter::Look(const FInputActionValue& Value)
 		AddControllerYawInput(LookAxisVector.X);
 		AddControllerPitchInput(LookAxisVector.Y);
 	}
-}
\ No newline at end of file
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Planet editing
+
+void ASGD240ProceduralCharacter::PlanetBrush(float BrushRadius, float Strength)
+{
+	// Trace from the camera to find the planet surface being looked at
+	const FVector TraceStart = FollowCamera->GetComponentLocation();
+	const FVector TraceEnd = TraceStart + FollowCamera->GetForwardVector() * 20000.0f;
+
+	FHitResult Hit;
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(PlanetBrush), false, this);
+	if (!GetWorld()->LineTraceSingleByChannel(Hit, TraceStart, TraceEnd, ECC_Visibility, Params))
+	{
+		return;
+	}
+
+	if (APlanetActor* Planet = Cast<APlanetActor>(Hit.GetActor()))
+	{
+		const EPlanetBrushMode Mode = Strength < 0.0f ? EPlanetBrushMode::Remove : EPlanetBrushMode::Add;
+		ServerApplyPlanetBrush(Planet, Hit.ImpactPoint, BrushRadius, FMath::Abs(Strength), Mode);
+	}
+}
+
+void ASGD240ProceduralCharacter::ServerApplyPlanetBrush_Implementation(APlanetActor* Planet, FVector_NetQuantize Location, float BrushRadius, float Strength, EPlanetBrushMode Mode)
+{
+	if (Planet)
+	{
+		Planet->ApplyBrush(Location, BrushRadius, Strength, Mode);
+	}
+}
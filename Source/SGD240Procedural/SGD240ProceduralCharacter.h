@@ -5,12 +5,14 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
 #include "Logging/LogMacros.h"
+#include "PlanetEditLog.h"
 #include "SGD240ProceduralCharacter.generated.h"
 
 class USpringArmComponent;
 class UCameraComponent;
 class UInputMappingContext;
 class UInputAction;
+class APlanetActor;
 struct FInputActionValue;
 
 DECLARE_LOG_CATEGORY_EXTERN(LogTemplateCharacter, Log, All);
@@ -55,6 +57,14 @@ protected:
 
 	/** Called for looking input */
 	void Look(const FInputActionValue& Value);
+
+	/** Console command to dig (negative strength) or build terrain where the camera is looking */
+	UFUNCTION(Exec)
+	void PlanetBrush(float BrushRadius, float Strength);
+
+	/** Forwards a brush edit to the server, which owns the planet's edit log */
+	UFUNCTION(Server, Reliable)
+	void ServerApplyPlanetBrush(APlanetActor* Planet, FVector_NetQuantize Location, float BrushRadius, float Strength, EPlanetBrushMode Mode);
 			
 
 protected: